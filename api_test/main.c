@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #define CMARK_NO_SHORT_NAMES
 #include "cmark.h"
@@ -243,6 +246,54 @@ static void accessors(test_batch_runner *runner) {
   cmark_node_free(doc);
 }
 
+static void accessors_n(test_batch_runner *runner) {
+  static const char markdown[] = "Hello *world* [link](/url \"title\")\n\n"
+                                 "``` info\ncode\n```\n";
+  cmark_node *doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                                         CMARK_OPT_DEFAULT);
+  cmark_node *para = cmark_node_first_child(doc);
+  cmark_node *text = cmark_node_first_child(para);
+  cmark_node *link = cmark_node_last_child(para);
+  cmark_node *code = cmark_node_next(para);
+  cmark_node *custom = cmark_node_new(CMARK_NODE_CUSTOM_INLINE);
+  const char *str;
+  size_t len;
+
+  str = cmark_node_get_literal_n(text, &len);
+  OK(runner, len == 6 && memcmp(str, "Hello ", 6) == 0, "get_literal_n");
+  OK(runner,
+     str == (const char *)text->as.literal.data && !text->as.literal.alloc,
+     "get_literal_n doesn't copy the literal");
+
+  str = cmark_node_get_literal_n(code, &len);
+  OK(runner, len == 5 && memcmp(str, "code\n", 5) == 0,
+     "get_literal_n on code block");
+  str = cmark_node_get_fence_info_n(code, &len);
+  OK(runner, len == 4 && memcmp(str, "info", 4) == 0, "get_fence_info_n");
+  str = cmark_node_get_url_n(link, &len);
+  OK(runner, len == 4 && memcmp(str, "/url", 4) == 0, "get_url_n");
+  str = cmark_node_get_title_n(link, &len);
+  OK(runner, len == 5 && memcmp(str, "title", 5) == 0, "get_title_n");
+
+  str = cmark_node_get_on_enter_n(custom, &len);
+  OK(runner, str != NULL && len == 0, "get_on_enter_n without on_enter");
+  cmark_node_set_on_enter(custom, "<x>");
+  cmark_node_set_on_exit(custom, "</x>");
+  str = cmark_node_get_on_enter_n(custom, &len);
+  OK(runner, len == 3 && memcmp(str, "<x>", 3) == 0, "get_on_enter_n");
+  str = cmark_node_get_on_exit_n(custom, &len);
+  OK(runner, len == 4 && memcmp(str, "</x>", 4) == 0, "get_on_exit_n");
+
+  len = 1;
+  OK(runner, cmark_node_get_url_n(text, &len) == NULL && len == 0,
+     "get_url_n on text");
+  OK(runner, cmark_node_get_literal_n(NULL, NULL) == NULL,
+     "get_literal_n on NULL");
+
+  cmark_node_free(custom);
+  cmark_node_free(doc);
+}
+
 static void node_check(test_batch_runner *runner) {
   // Construct an incomplete tree.
   cmark_node *doc = cmark_node_new(CMARK_NODE_DOCUMENT);
@@ -888,6 +939,42 @@ static void test_feed_across_line_ending(test_batch_runner *runner) {
   cmark_node_free(document);
 }
 
+// Feeds a copy of str that is freed right away, so that reading past
+// its end or keeping a pointer into it shows up under a sanitizer.
+static void feed_copy(cmark_parser *parser, const char *str) {
+  size_t len = strlen(str);
+  char *copy = (char *)malloc(len);
+  memcpy(copy, str, len);
+  cmark_parser_feed(parser, copy, len);
+  free(copy);
+}
+
+static void test_feed_in_place(test_batch_runner *runner) {
+  // Lines ending in LF are processed in the fed buffer itself.
+  cmark_parser *parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  feed_copy(parser, "#\n");
+  cmark_node *document = cmark_parser_finish(parser);
+  char *html = cmark_render_html(document, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html, "<h1></h1>\n", "empty heading at end of buffer");
+  free(html);
+  cmark_node_free(document);
+
+  // Lines split across feeds are put together in the parser first.
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  feed_copy(parser, "# he");
+  feed_copy(parser, "ading\nfoo\n> quo");
+  feed_copy(parser, "te\n");
+  document = cmark_parser_finish(parser);
+  html = cmark_render_html(document, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html,
+         "<h1>heading</h1>\n<p>foo</p>\n"
+         "<blockquote>\n<p>quote</p>\n</blockquote>\n",
+         "lines split across feeds");
+  free(html);
+  cmark_node_free(document);
+  cmark_parser_free(parser);
+}
+
 static void source_pos(test_batch_runner *runner) {
   static const char markdown[] =
     "# Hi *there*.\n"
@@ -1024,6 +1111,802 @@ static void ref_source_pos(test_batch_runner *runner) {
   cmark_node_free(doc);
 }
 
+static void arena(test_batch_runner *runner) {
+  cmark_mem *mem = cmark_get_arena_mem_allocator();
+  static const char markdown[] = "# Heading\n\n"
+                                 "Some *emphasis*, a [link][ref].\n\n"
+                                 "[ref]: /url \"title\"\n";
+  cmark_parser *parser;
+  cmark_node *doc, *para;
+  char *html, *buf = NULL;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, mem);
+    cmark_parser_feed(parser, markdown, sizeof(markdown) - 1);
+    doc = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    OK(runner, cmark_node_mem(doc) == mem, "arena doc uses arena mem");
+
+    para = cmark_node_next(cmark_node_first_child(doc));
+    cmark_node_free(cmark_node_first_child(para));
+    OK(runner, cmark_node_first_child(para) != NULL &&
+                   cmark_node_get_type(cmark_node_first_child(para)) ==
+                       CMARK_NODE_EMPH,
+       "cmark_node_free unlinks arena node");
+
+    html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+    STR_EQ(runner, html,
+           "<h1>Heading</h1>\n"
+           "<p><em>emphasis</em>, a <a href=\"/url\" "
+           "title=\"title\">link</a>.</p>\n",
+           "render arena doc, iteration %d", i);
+    cmark_node_free(doc);
+    cmark_arena_reset();
+  }
+
+  // Grow a buffer well past the arena chunk size to exercise both
+  // in-place extension and copying reallocs.
+  for (i = 0; i < 100000; i++) {
+    buf = (char *)mem->realloc(buf, (i + 1) * 10);
+    memcpy(buf + i * 10, "0123456789", 10);
+    if (i % 1000 == 0)
+      mem->calloc(1, 100);
+  }
+  OK(runner,
+     memcmp(buf, "0123456789", 10) == 0 &&
+         memcmp(buf + 999990, "0123456789", 10) == 0,
+     "arena realloc preserves contents");
+  cmark_arena_release();
+}
+
+static void retain_source(test_batch_runner *runner) {
+  static const char markdown[] = "# Title <http://a.b>\n\n"
+                                 "Hello [world\nand *more* <b>tags</b>\n\n"
+                                 "[ref]: /url\nA [link](/u \"t\") to [ref].\n";
+  size_t len = sizeof(markdown) - 1;
+  char *buf = (char *)malloc(len);
+  cmark_parser *parser;
+  cmark_node *doc, *text;
+  char *html, *expected;
+  FILE *file;
+  size_t i;
+
+  memcpy(buf, markdown, len);
+  doc = cmark_parse_document(buf, len, CMARK_OPT_RETAIN_SOURCE);
+  cmark_consolidate_text_nodes(doc);
+  text = cmark_node_first_child(cmark_node_next(cmark_node_first_child(doc)));
+  STR_EQ(runner, cmark_node_get_literal(text), "Hello [world",
+         "consolidate text nodes pointing into the input");
+  html = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  STR_EQ(runner, html,
+         "<h1>Title <a href=\"http://a.b\">http://a.b</a></h1>\n"
+         "<p>Hello [world\nand <em>more</em> <b>tags</b></p>\n"
+         "<p>A <a href=\"/u\" title=\"t\">link</a> to "
+         "<a href=\"/url\">ref</a>.</p>\n",
+         "render tree that points into the input");
+  free(html);
+  cmark_node_free(doc);
+
+  // Feed the input in pieces, keeping all of them alive.
+  parser = cmark_parser_new(CMARK_OPT_RETAIN_SOURCE);
+  for (i = 0; i < len; i += 7)
+    cmark_parser_feed(parser, buf + i, len - i < 7 ? len - i : 7);
+  doc = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  html = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  STR_EQ(runner, html,
+         "<h1>Title <a href=\"http://a.b\">http://a.b</a></h1>\n"
+         "<p>Hello [world\nand <em>more</em> <b>tags</b></p>\n"
+         "<p>A <a href=\"/u\" title=\"t\">link</a> to "
+         "<a href=\"/url\">ref</a>.</p>\n",
+         "render tree fed in pieces that are kept alive");
+  free(html);
+  cmark_node_free(doc);
+  free(buf);
+
+  // cmark_parse_file reuses its read buffer, so it copies the text
+  // anyway.
+  file = tmpfile();
+  for (i = 0; i < 100; i++)
+    fwrite(markdown, 1, len, file);
+  rewind(file);
+  doc = cmark_parse_file(file, CMARK_OPT_RETAIN_SOURCE);
+  fclose(file);
+  html = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  cmark_node_free(doc);
+  buf = (char *)malloc(len * 100);
+  for (i = 0; i < 100; i++)
+    memcpy(buf + i * len, markdown, len);
+  doc = cmark_parse_document(buf, len * 100, CMARK_OPT_DEFAULT);
+  expected = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  STR_EQ(runner, html, expected, "parse file ignoring retain source");
+  free(expected);
+  free(html);
+  cmark_node_free(doc);
+  free(buf);
+}
+
+static void parser_reset(test_batch_runner *runner) {
+  static const char with_ref[] = "[foo]: /url\n\nA [foo] link.\n";
+  static const char no_ref[] = "No [foo] link, \"quoted\".\n";
+  static const char comment[] = "A *short* comment with a [link](/u).\n";
+  size_t comment_len = sizeof(comment) - 1;
+  cmark_parser *parser;
+  cmark_node *doc;
+  char *html, *expected;
+  int i, mismatches = 0;
+
+  parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, with_ref, sizeof(with_ref) - 1);
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html, "<p>A <a href=\"/url\">foo</a> link.</p>\n",
+         "parse before reset");
+  free(html);
+  cmark_node_free(doc);
+
+  // References and options do not carry over.
+  cmark_parser_reset(parser, CMARK_OPT_SMART);
+  cmark_parser_feed(parser, no_ref, sizeof(no_ref) - 1);
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html,
+         "<p>No [foo] link, \xe2\x80\x9cquoted\xe2\x80\x9d.</p>\n",
+         "parse after reset");
+  free(html);
+  cmark_node_free(doc);
+
+  // Abandon a document halfway.
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, "> unfinished\n> - list", 21);
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, with_ref, sizeof(with_ref) - 1);
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html, "<p>A <a href=\"/url\">foo</a> link.</p>\n",
+         "parse after abandoning a document");
+  free(html);
+  cmark_node_free(doc);
+
+  doc = cmark_parse_document(comment, comment_len, CMARK_OPT_DEFAULT);
+  expected = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  cmark_node_free(doc);
+
+  for (i = 0; i < 20; i++) {
+    cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+    cmark_parser_feed(parser, comment, comment_len);
+    doc = cmark_parser_finish(parser);
+    html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+    if (strcmp(html, expected) != 0)
+      mismatches++;
+    free(html);
+    cmark_node_free(doc);
+  }
+  INT_EQ(runner, mismatches, 0, "documents parsed with a reused parser");
+
+  // Finishing twice gives nothing the second time, and feeding a
+  // finished parser starts a new document.
+  cmark_parser_reset(parser, CMARK_OPT_SMART);
+  cmark_parser_feed(parser, with_ref, sizeof(with_ref) - 1);
+  doc = cmark_parser_finish(parser);
+  OK(runner, cmark_parser_finish(parser) == NULL, "finish twice");
+  cmark_node_free(doc);
+  cmark_parser_feed(parser, no_ref, sizeof(no_ref) - 1);
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html,
+         "<p>No [foo] link, \xe2\x80\x9cquoted\xe2\x80\x9d.</p>\n",
+         "feed after finish");
+  free(html);
+  cmark_node_free(doc);
+
+  // Free a parser in the middle of a document.
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, with_ref, sizeof(with_ref) - 1);
+  cmark_parser_free(parser);
+  free(expected);
+}
+
+static void parallel_inlines(test_batch_runner *runner) {
+  static const char block[] =
+      "# Heading with *emphasis* and `code`\n\n"
+      "A paragraph with **strong *nested* text**, a [reference][ref],\n"
+      "an <http://auto.link>, an &amp; entity and \"smart\" quotes...\n\n"
+      "- a list item with _emphasis_ and [a link](/url \"title\")\n"
+      "- ![an image](/img.png) and <b>inline html</b>\n\n"
+      "> A quote with *unclosed emphasis and a [bracket\n\n";
+  static const char refs[] = "[ref]: /reference \"Reference\"\n";
+  static const int opts[] = {CMARK_OPT_DEFAULT,
+                             CMARK_OPT_SOURCEPOS | CMARK_OPT_SMART,
+                             CMARK_OPT_RETAIN_SOURCE};
+  size_t block_len = sizeof(block) - 1;
+  size_t len = 4000 * block_len + sizeof(refs) - 1;
+  char *markdown = (char *)malloc(len);
+  cmark_parser *parser;
+  cmark_node *doc;
+  char *serial, *parallel;
+  size_t i;
+  int t;
+
+  for (i = 0; i < 4000; i++)
+    memcpy(markdown + i * block_len, block, block_len);
+  memcpy(markdown + 4000 * block_len, refs, sizeof(refs) - 1);
+
+  for (t = 0; t < 3; t++) {
+    doc = cmark_parse_document(markdown, len, opts[t]);
+    serial = cmark_render_xml(doc, opts[t]);
+    cmark_node_free(doc);
+
+    parser = cmark_parser_new(opts[t]);
+    cmark_parser_set_threads(parser, 4);
+    cmark_parser_feed(parser, markdown, len);
+    doc = cmark_parser_finish(parser);
+    parallel = cmark_render_xml(doc, opts[t]);
+    OK(runner,
+       strcmp(serial, parallel) == 0 && cmark_node_check(doc, NULL) == 0,
+       "tree with inlines parsed on 4 threads");
+    free(parallel);
+    cmark_node_free(doc);
+
+    // Again, with a reused parser.
+    cmark_parser_reset(parser, opts[t]);
+    cmark_parser_feed(parser, markdown, len);
+    doc = cmark_parser_finish(parser);
+    parallel = cmark_render_xml(doc, opts[t]);
+    OK(runner, strcmp(serial, parallel) == 0,
+       "tree with inlines parsed on 4 threads after reset");
+    free(parallel);
+    cmark_node_free(doc);
+    cmark_parser_free(parser);
+    free(serial);
+  }
+
+  free(markdown);
+}
+
+static void parallel_blocks(test_batch_runner *runner) {
+  // Pieces may start at "Text", "Fenced" and "Done"; only "Text" is
+  // between blocks.
+  static const char block[] = "Text with a [ref] and *emphasis*\n\n"
+                              "- a list\n- [dup]\n\n"
+                              "```c\nFenced\n\nFenced\n```\n\n"
+                              "<!--\nDone\n\nDone -->\n\n"
+                              "[dup]: /first\n\nLast line\n\n";
+  static const char refs[] = "[ref]: /reference\n[dup]: /second\n";
+  static const int opts[] = {CMARK_OPT_SOURCEPOS,
+                             CMARK_OPT_SMART | CMARK_OPT_RETAIN_SOURCE};
+  size_t block_len = sizeof(block) - 1;
+  size_t len = 10000 * block_len + sizeof(refs) - 1;
+  char *markdown = (char *)malloc(len);
+  cmark_node *doc;
+  char *serial, *parallel;
+  size_t i;
+  int t;
+
+  for (i = 0; i < 10000; i++)
+    memcpy(markdown + i * block_len, block, block_len);
+  memcpy(markdown + 10000 * block_len, refs, sizeof(refs) - 1);
+
+  for (t = 0; t < 2; t++) {
+    doc = cmark_parse_document(markdown, len, opts[t]);
+    serial = cmark_render_xml(doc, opts[t]);
+    cmark_node_free(doc);
+
+    doc = cmark_parse_document_parallel(markdown, len, opts[t], 8);
+    parallel = cmark_render_xml(doc, opts[t]);
+    OK(runner,
+       strcmp(serial, parallel) == 0 && cmark_node_check(doc, NULL) == 0,
+       "document parsed in pieces");
+    free(parallel);
+    cmark_node_free(doc);
+
+    // Without a line ending at the end.
+    doc = cmark_parse_document(markdown, len - 1, opts[t]);
+    free(serial);
+    serial = cmark_render_xml(doc, opts[t]);
+    cmark_node_free(doc);
+    doc = cmark_parse_document_parallel(markdown, len - 1, opts[t], 3);
+    parallel = cmark_render_xml(doc, opts[t]);
+    OK(runner, strcmp(serial, parallel) == 0,
+       "document parsed in pieces, without final newline");
+    free(parallel);
+    cmark_node_free(doc);
+    free(serial);
+  }
+
+  free(markdown);
+}
+
+static void parallel_render(test_batch_runner *runner) {
+  static const char block[] = "# Heading\n\n"
+                              "Some *emphasis* and a [link](/url).\n\n"
+                              "- item\n- item\n\n"
+                              "    code\n\n"
+                              "<div>raw</div>\n\n";
+  size_t block_len = sizeof(block) - 1;
+  size_t len = 20000 * block_len;
+  char *markdown = (char *)malloc(len);
+  cmark_mem *arena = cmark_get_arena_mem_allocator();
+  cmark_parser *parser;
+  cmark_node *doc, *node;
+  char *serial, *parallel;
+  size_t i;
+
+  for (i = 0; i < 20000; i++)
+    memcpy(markdown + i * block_len, block, block_len);
+  doc = cmark_parse_document(markdown, len, CMARK_OPT_SOURCEPOS);
+  serial = cmark_render_html(doc, CMARK_OPT_SOURCEPOS);
+  parallel = cmark_render_html_parallel(doc, CMARK_OPT_SOURCEPOS, 4);
+  STR_EQ(runner, parallel, serial, "render document on 4 threads");
+  free(parallel);
+  cmark_node_free(doc);
+
+  // Arena trees are rendered on the calling thread, into its arena.
+  parser = cmark_parser_new_with_mem(CMARK_OPT_SOURCEPOS, arena);
+  cmark_parser_feed(parser, markdown, len);
+  doc = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  parallel = cmark_render_html_parallel(doc, CMARK_OPT_SOURCEPOS, 4);
+  STR_EQ(runner, parallel, serial, "render arena document on 4 threads");
+  cmark_arena_release();
+  free(serial);
+  free(markdown);
+
+  // HTML blocks not ending in a newline still end their output with
+  // one.
+  doc = cmark_node_new(CMARK_NODE_DOCUMENT);
+  for (i = 0; i < 20000; i++) {
+    node = cmark_node_new(CMARK_NODE_HTML_BLOCK);
+    cmark_node_set_literal(node, i % 3 ? "<hr>" : "<hr>\n");
+    cmark_node_append_child(doc, node);
+  }
+  serial = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  parallel = cmark_render_html_parallel(doc, CMARK_OPT_UNSAFE, 7);
+  STR_EQ(runner, parallel, serial, "render built document on 7 threads");
+  free(parallel);
+  free(serial);
+  cmark_node_free(doc);
+}
+
+typedef struct {
+  char *data;
+  size_t size;
+  size_t largest;
+  int writes;
+  int stop_after;
+} stream_sink;
+
+static int stream_write(const char *data, size_t len, void *userdata) {
+  stream_sink *sink = (stream_sink *)userdata;
+
+  sink->data = (char *)realloc(sink->data, sink->size + len + 1);
+  memcpy(sink->data + sink->size, data, len);
+  sink->size += len;
+  sink->data[sink->size] = '\0';
+  if (len > sink->largest)
+    sink->largest = len;
+  return ++sink->writes == sink->stop_after ? 42 : 0;
+}
+
+static void render_html_to(test_batch_runner *runner) {
+  static const char block[] = "# Heading\n\n"
+                              "Some *emphasis* & a [link](/url).\n\n"
+                              "    code <&>\n\n"
+                              "<div>raw</div>\n\n";
+  size_t block_len = sizeof(block) - 1;
+  size_t len = 10000 * block_len + 200000;
+  char *markdown = (char *)malloc(len);
+  cmark_node *doc, *node;
+  stream_sink sink;
+  char *expected;
+  size_t i;
+  int status;
+
+  // Many blocks, then a code block too long for one write.
+  for (i = 0; i < 10000; i++)
+    memcpy(markdown + i * block_len, block, block_len);
+  memcpy(markdown + 10000 * block_len, "```\n", 4);
+  for (i = 10000 * block_len + 4; i < len; i++)
+    markdown[i] = i % 80 ? "<&>"[i % 3] : '\n';
+  doc = cmark_parse_document(markdown, len, CMARK_OPT_SOURCEPOS);
+  expected = cmark_render_html(doc, CMARK_OPT_SOURCEPOS | CMARK_OPT_UNSAFE);
+
+  memset(&sink, 0, sizeof(sink));
+  status = cmark_render_html_to(doc, CMARK_OPT_SOURCEPOS | CMARK_OPT_UNSAFE,
+                                stream_write, &sink);
+  INT_EQ(runner, status, 0, "streamed render succeeds");
+  STR_EQ(runner, sink.data, expected,
+         "streamed render matches cmark_render_html");
+  OK(runner, sink.writes > 10 && sink.largest < 128 * 1024,
+     "streamed render writes in small pieces");
+  free(expected);
+
+  // The write callback stops rendering.
+  sink.size = 0;
+  sink.writes = 0;
+  sink.stop_after = 3;
+  status = cmark_render_html_to(doc, CMARK_OPT_DEFAULT, stream_write, &sink);
+  INT_EQ(runner, status, 42, "write callback's status is returned");
+  INT_EQ(runner, sink.writes, 3, "no writes after the callback fails");
+  cmark_node_free(doc);
+  free(markdown);
+
+  // HTML blocks not ending in a newline are followed by one, also when
+  // the output is flushed in between.
+  doc = cmark_node_new(CMARK_NODE_DOCUMENT);
+  for (i = 0; i < 20000; i++) {
+    node = cmark_node_new(CMARK_NODE_HTML_BLOCK);
+    cmark_node_set_literal(node, i % 3 ? "<hr>" : "<hr>\n");
+    cmark_node_append_child(doc, node);
+  }
+  sink.size = 0;
+  sink.stop_after = 0;
+  cmark_render_html_to(doc, CMARK_OPT_UNSAFE, stream_write, &sink);
+  expected = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  STR_EQ(runner, sink.data, expected,
+         "stream built document");
+  free(expected);
+  cmark_node_free(doc);
+
+  // URLs, titles and info strings too long for one write.
+  len = 300000;
+  markdown = (char *)malloc(len + 1);
+  for (i = 0; i < len; i++)
+    markdown[i] = "a&'\" <"[i % 6];
+  markdown[len] = '\0';
+  doc = cmark_node_new(CMARK_NODE_DOCUMENT);
+  node = cmark_node_new(CMARK_NODE_CODE_BLOCK);
+  cmark_node_set_fence_info(node, markdown);
+  cmark_node_append_child(doc, node);
+  node = cmark_node_new(CMARK_NODE_PARAGRAPH);
+  cmark_node_append_child(doc, node);
+  for (i = 0; i < 2; i++) {
+    cmark_node *link =
+        cmark_node_new(i == 0 ? CMARK_NODE_LINK : CMARK_NODE_IMAGE);
+    cmark_node_set_url(link, markdown);
+    cmark_node_set_title(link, markdown);
+    cmark_node_append_child(node, link);
+  }
+  free(markdown);
+  sink.size = 0;
+  sink.writes = 0;
+  sink.largest = 0;
+  cmark_render_html_to(doc, CMARK_OPT_UNSAFE, stream_write, &sink);
+  expected = cmark_render_html(doc, CMARK_OPT_UNSAFE);
+  STR_EQ(runner, sink.data, expected, "stream long attributes");
+  OK(runner, sink.largest < 128 * 1024,
+     "long attributes are written in small pieces");
+  free(expected);
+  cmark_node_free(doc);
+
+  free(sink.data);
+}
+
+static void batch_convert(test_batch_runner *runner) {
+  static const char *const samples[] = {
+      "# Heading\n\nA *short* comment with a [link](/u).\n",
+      "[ref]: /url\n\nUses [ref] and \"quotes\".\n",
+      "- one\n- two\n  - nested `code`\n",
+      "> quote\n\n```c\nint x;\n```\n",
+      "",
+      "<div>\nhtml\n</div>\n\n---\n"};
+  const int num_samples = sizeof(samples) / sizeof(*samples);
+  const char *docs[100];
+  size_t lens[100];
+  char *out[100];
+  char *expected;
+  cmark_mem *arena = cmark_get_arena_mem_allocator();
+  cmark_parser *parser;
+  cmark_node *doc;
+  int i, threads, mismatches;
+
+  for (i = 0; i < 100; i++) {
+    docs[i] = samples[i % num_samples];
+    lens[i] = strlen(docs[i]);
+  }
+
+  // A document in the calling thread's arena outlives the batch.
+  parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, arena);
+  cmark_parser_feed(parser, docs[0], lens[0]);
+  doc = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+
+  for (threads = 0; threads <= 200; threads = threads ? threads * 4 : 1) {
+    mismatches = 0;
+    cmark_markdown_to_html_batch(docs, lens, 100, CMARK_OPT_SMART, threads,
+                                 out);
+    for (i = 0; i < 100; i++) {
+      expected = cmark_markdown_to_html(docs[i], lens[i], CMARK_OPT_SMART);
+      if (strcmp(out[i], expected) != 0)
+        mismatches++;
+      free(expected);
+      free(out[i]);
+    }
+    INT_EQ(runner, mismatches, 0, "batch of 100 documents on %d threads",
+           threads);
+  }
+
+  cmark_markdown_to_html_batch(docs, lens, 0, CMARK_OPT_DEFAULT, 4, out);
+
+  out[0] = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  expected = cmark_markdown_to_html(docs[0], lens[0], CMARK_OPT_DEFAULT);
+  STR_EQ(runner, out[0], expected, "caller's arena survives a batch");
+  free(expected);
+  cmark_arena_reset();
+}
+
+// Sanitizer builds allocate nodes one by one; see src/slab.c.
+#if defined(__SANITIZE_ADDRESS__)
+#define SLAB_DISABLED
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SLAB_DISABLED
+#endif
+#endif
+
+static int slab_allocs = 0;
+
+static void *counting_calloc(size_t nmem, size_t size) {
+  slab_allocs++;
+  return calloc(nmem, size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+  if (!ptr)
+    slab_allocs++;
+  return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr) {
+  if (ptr)
+    slab_allocs--;
+  free(ptr);
+}
+
+static void node_slab(test_batch_runner *runner) {
+  static const char markdown[] = "# Heading\n\n"
+                                 "Some *emphasis* and **strong** text\n"
+                                 "with a [link](/url) and `code`.\n\n"
+                                 "- one\n- two\n- three\n\n"
+                                 "> quoted *text*\n";
+  cmark_mem counting_mem = {counting_calloc, counting_realloc,
+                            counting_free};
+  cmark_parser *parser;
+  cmark_node *doc, *node, *next, *emph, *list;
+  char *html, *expected;
+  int i, j, mismatches = 0;
+
+  doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                             CMARK_OPT_DEFAULT);
+  expected = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  cmark_node_free(doc);
+
+  // Build and free trees, restyling each paragraph the way an editor
+  // would: wrap its children in a new emphasis, unwrap them again, and
+  // grow and shrink a list.  bench/api_bench.c times the same.
+  for (i = 0; i < 20; i++) {
+    doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                               CMARK_OPT_DEFAULT);
+    list = cmark_node_new(CMARK_NODE_LIST);
+    for (j = 0; j < 20; j++) {
+      cmark_node *item = cmark_node_new(CMARK_NODE_ITEM);
+      cmark_node *para = cmark_node_new(CMARK_NODE_PARAGRAPH);
+      cmark_node *text = cmark_node_new(CMARK_NODE_TEXT);
+      cmark_node_set_literal(text, "item");
+      cmark_node_append_child(para, text);
+      cmark_node_append_child(item, para);
+      cmark_node_append_child(list, item);
+    }
+    cmark_node_append_child(doc, list);
+
+    for (node = cmark_node_first_child(doc); node;
+         node = cmark_node_next(node)) {
+      if (cmark_node_get_type(node) != CMARK_NODE_PARAGRAPH)
+        continue;
+      emph = cmark_node_new(CMARK_NODE_EMPH);
+      while (cmark_node_first_child(node))
+        cmark_node_append_child(emph, cmark_node_first_child(node));
+      cmark_node_append_child(node, emph);
+      while (cmark_node_first_child(emph))
+        cmark_node_insert_before(emph, cmark_node_first_child(emph));
+      cmark_node_free(emph);
+    }
+
+    // Free every other item, then the rest along with the document.
+    for (node = cmark_node_first_child(list); node; node = next) {
+      next = cmark_node_next(node);
+      if (next)
+        next = cmark_node_next(next);
+      cmark_node_free(node);
+    }
+    cmark_node_free(list);
+
+    html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+    if (strcmp(html, expected) != 0 || cmark_node_check(doc, NULL) != 0)
+      mismatches++;
+    free(html);
+    cmark_node_free(doc);
+  }
+  INT_EQ(runner, mismatches, 0, "trees built, edited and freed");
+  free(expected);
+
+  // Chunks go back to their allocator with their last node, whether
+  // the parser is freed before or after the tree.
+  for (i = 0; i < 2; i++) {
+    parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, &counting_mem);
+    for (j = 0; j < 50; j++)
+      cmark_parser_feed(parser, markdown, sizeof(markdown) - 1);
+    doc = cmark_parser_finish(parser);
+    if (i == 0)
+      cmark_parser_free(parser);
+    for (j = 0; (node = cmark_node_first_child(doc)) != NULL; j++) {
+      // Free the children out of order.
+      if (j % 2 && cmark_node_next(node))
+        node = cmark_node_next(node);
+      cmark_node_free(node);
+    }
+    cmark_node_free(doc);
+    if (i == 1)
+      cmark_parser_free(parser);
+    INT_EQ(runner, slab_allocs, 0, "chunks are released (%s)",
+           i == 0 ? "parser freed first" : "parser freed last");
+  }
+}
+
+#ifndef SLAB_DISABLED
+// New nodes take the slots of freed ones, those of a parsed tree as
+// well as those of nodes created through the API, without asking the
+// allocator for more.
+static void node_reuse(test_batch_runner *runner) {
+  static const char markdown[] = "# Heading\n\n"
+                                 "Some *emphasis* and **strong** text\n"
+                                 "with a [link](/url) and `code`.\n\n"
+                                 "- one\n- two\n- three\n\n"
+                                 "> quoted *text*\n";
+  cmark_mem counting_mem = {counting_calloc, counting_realloc,
+                            counting_free};
+  cmark_parser *parser;
+  cmark_node *doc, *node, *next, *para;
+  cmark_iter *iter;
+  int i, j, freed = 0, allocs;
+
+  parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, &counting_mem);
+  for (j = 0; j < 50; j++)
+    cmark_parser_feed(parser, markdown, sizeof(markdown) - 1);
+  doc = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  for (i = 0, node = cmark_node_first_child(doc); node; node = next, i++) {
+    next = cmark_node_next(node);
+    if (i % 2)
+      continue;
+    iter = cmark_iter_new(node);
+    while (cmark_iter_next(iter) != CMARK_EVENT_DONE)
+      if (cmark_iter_get_event_type(iter) == CMARK_EVENT_ENTER)
+        freed++;
+    cmark_iter_free(iter);
+    cmark_node_unlink(node);
+    cmark_node_free(node);
+  }
+  allocs = slab_allocs;
+  para = cmark_node_new_with_mem(CMARK_NODE_PARAGRAPH, &counting_mem);
+  for (j = 1; j < freed; j++)
+    cmark_node_append_child(
+        para, cmark_node_new_with_mem(CMARK_NODE_EMPH, &counting_mem));
+  INT_EQ(runner, slab_allocs, allocs, "slots of parsed nodes are reused");
+
+  // Now free every other of those and make as many again.
+  for (j = 0, node = cmark_node_first_child(para); node; node = next, j++) {
+    next = cmark_node_next(node);
+    if (j % 2)
+      cmark_node_free(node);
+  }
+  allocs = slab_allocs;
+  for (j = 1; j < freed; j += 2)
+    cmark_node_append_child(
+        para, cmark_node_new_with_mem(CMARK_NODE_EMPH, &counting_mem));
+  INT_EQ(runner, slab_allocs, allocs, "slots of created nodes are reused");
+  cmark_node_append_child(doc, para);
+  INT_EQ(runner, cmark_node_check(doc, NULL), 0, "tree intact");
+  cmark_node_free(doc);
+  INT_EQ(runner, slab_allocs, 0, "chunks are released (nodes reused)");
+}
+#endif
+
+#ifdef HAVE_PTHREADS
+#define RENDER_THREADS 4
+#define RENDER_FORMATS 5
+
+static char *render_format(cmark_node *doc, int format) {
+  switch (format) {
+  case 0:
+    return cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  case 1:
+    return cmark_render_xml(doc, CMARK_OPT_DEFAULT);
+  case 2:
+    return cmark_render_man(doc, CMARK_OPT_DEFAULT, 20);
+  case 3:
+    return cmark_render_commonmark(doc, CMARK_OPT_DEFAULT, 20);
+  default:
+    return cmark_render_latex(doc, CMARK_OPT_DEFAULT, 20);
+  }
+}
+
+typedef struct {
+  cmark_node *doc;
+  char **expected;
+  int mismatches;
+} render_job;
+
+static void *render_thread(void *arg) {
+  render_job *job = (render_job *)arg;
+  int i, format;
+
+  for (i = 0; i < 20; i++) {
+    for (format = 0; format < RENDER_FORMATS; format++) {
+      char *out = render_format(job->doc, format);
+      if (strcmp(out, job->expected[format]) != 0)
+        job->mismatches++;
+      free(out);
+    }
+  }
+  return NULL;
+}
+
+static void concurrent_render(test_batch_runner *runner) {
+  static const char markdown[] =
+      "# Heading with `code`\n\n"
+      "Text with <http://example.com/> and [http://a.b](http://a.b),\n"
+      "<me@example.com>, [a [b] c](/url \"title\") and ![img](/i.png).\n\n"
+      "> quote *emph* **strong** <span>html</span>\\\n"
+      "> hard break\n\n"
+      "1. item\n2. item\n\n"
+      "```lang\nfenced code\n```\n\n"
+      "    indented code\n\n"
+      "<div>\nhtml block\n</div>\n\n"
+      "---\n";
+  cmark_node *doc, *custom;
+  char *expected[RENDER_FORMATS];
+  pthread_t threads[RENDER_THREADS];
+  render_job jobs[RENDER_THREADS];
+  int i, mismatches = 0;
+
+  // The expected output is rendered from a separate copy of the tree,
+  // so the threads are the first to render theirs.
+  for (i = 0; i < 2; i++) {
+    doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                               CMARK_OPT_DEFAULT);
+    custom = cmark_node_new(CMARK_NODE_CUSTOM_BLOCK);
+    cmark_node_set_on_enter(custom, "<custom>");
+    cmark_node_set_on_exit(custom, "</custom>");
+    cmark_node_append_child(doc, custom);
+    if (i == 0) {
+      int format;
+      for (format = 0; format < RENDER_FORMATS; format++)
+        expected[format] = render_format(doc, format);
+      cmark_node_free(doc);
+    }
+  }
+
+  for (i = 0; i < RENDER_THREADS; i++) {
+    jobs[i].doc = doc;
+    jobs[i].expected = expected;
+    jobs[i].mismatches = 0;
+    pthread_create(&threads[i], NULL, render_thread, &jobs[i]);
+  }
+  for (i = 0; i < RENDER_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    mismatches += jobs[i].mismatches;
+  }
+  INT_EQ(runner, mismatches, 0, "render the same tree from %d threads",
+         RENDER_THREADS);
+
+  for (i = 0; i < RENDER_FORMATS; i++)
+    free(expected[i]);
+  cmark_node_free(doc);
+}
+#endif
+
 int main() {
   int retval;
   test_batch_runner *runner = test_batch_runner_new();
@@ -1031,6 +1914,7 @@ int main() {
   version(runner);
   constructor(runner);
   accessors(runner);
+  accessors_n(runner);
   node_check(runner);
   iterator(runner);
   iterator_delete(runner);
@@ -1049,9 +1933,25 @@ int main() {
   test_cplusplus(runner);
   test_safe(runner);
   test_feed_across_line_ending(runner);
+  test_feed_in_place(runner);
   source_pos(runner);
   source_pos_inlines(runner);
   ref_source_pos(runner);
+  arena(runner);
+  retain_source(runner);
+  parser_reset(runner);
+  parallel_inlines(runner);
+  parallel_blocks(runner);
+  parallel_render(runner);
+  render_html_to(runner);
+  batch_convert(runner);
+  node_slab(runner);
+#ifndef SLAB_DISABLED
+  node_reuse(runner);
+#endif
+#ifdef HAVE_PTHREADS
+  concurrent_render(runner);
+#endif
 
   test_print_summary(runner);
   retval = test_ok(runner) ? 0 : 1;
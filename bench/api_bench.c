@@ -0,0 +1,336 @@
+#ifdef HAVE_PTHREADS
+// For clock_gettime.
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "cmark.h"
+#ifdef CMARK_STATIC_DEFINE
+#include "simd.h"
+#endif
+
+// Timings of library calls that the cmark program does not exercise,
+// and of the scans the parser is built on.  Not built by default:
+// configure with -DCMARK_BENCH=ON, or run `make apibench`.
+
+static double cpu_ms(clock_t start) {
+  return (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+}
+
+#ifdef CMARK_STATIC_DEFINE
+#define SCAN_COPIES 2000
+#define SCAN_PASSES 20
+
+// What S_parser_feed looks for to find the end of a line.
+#define LINE_END(n)                                                            \
+  CMARK_BYTESET_NIB('\r', n) | CMARK_BYTESET_NIB('\n', n) |                    \
+      CMARK_BYTESET_NIB('\0', n)
+// Where the inline parser stops, without CMARK_OPT_SMART (see
+// subject_find_special_char).
+#define SPECIAL(n)                                                             \
+  CMARK_BYTESET_NIB('\r', n) | CMARK_BYTESET_NIB('\n', n) |                    \
+      CMARK_BYTESET_NIB('\\', n) | CMARK_BYTESET_NIB('`', n) |                  \
+      CMARK_BYTESET_NIB('&', n) | CMARK_BYTESET_NIB('_', n) |                   \
+      CMARK_BYTESET_NIB('*', n) | CMARK_BYTESET_NIB('[', n) |                   \
+      CMARK_BYTESET_NIB(']', n) | CMARK_BYTESET_NIB('<', n) |                   \
+      CMARK_BYTESET_NIB('!', n)
+static const cmark_byteset line_end_chars = CMARK_BYTESET(LINE_END, false);
+static const cmark_byteset special_chars = CMARK_BYTESET(SPECIAL, false);
+#undef LINE_END
+#undef SPECIAL
+
+// Reads SCAN_COPIES copies of a sample from bench/samples.
+static char *read_sample(const char *name, size_t *len) {
+  char path[512];
+  FILE *file;
+  char *data;
+  long size;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/%s", CMARK_BENCH_SAMPLES, name);
+  file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  rewind(file);
+  data = (char *)malloc((size_t)size * SCAN_COPIES);
+  if (fread(data, 1, (size_t)size, file) != (size_t)size) {
+    fclose(file);
+    free(data);
+    return NULL;
+  }
+  fclose(file);
+  for (i = 1; i < SCAN_COPIES; i++)
+    memcpy(data + (size_t)size * i, data, (size_t)size);
+  *len = (size_t)size * SCAN_COPIES;
+  return data;
+}
+
+// Stops at every byte of data in set, looking at one byte at a time,
+// and returns how often it stopped.
+static long scan_bytes(const cmark_byteset *set, const uint8_t *data,
+                       bufsize_t len) {
+  long stops = 0;
+  bufsize_t i;
+
+  for (i = 0; i < len; i++) {
+    if (cmark_byteset_contains(set, data[i]))
+      stops++;
+  }
+  return stops;
+}
+
+// The same with cmark_byteset_find, searching from the byte after each
+// stop as the parser does.
+static long scan_find(const cmark_byteset *set, const uint8_t *data,
+                      bufsize_t len) {
+  long stops = 0;
+  bufsize_t i = 0;
+
+  while ((i += cmark_byteset_find(set, data + i, len - i)) < len) {
+    stops++;
+    i++;
+  }
+  return stops;
+}
+
+// Milliseconds per pass of scan over data.
+static double scan_ms(long (*scan)(const cmark_byteset *, const uint8_t *,
+                                   bufsize_t),
+                      const cmark_byteset *set, const char *data, size_t len,
+                      long *stops) {
+  clock_t start = clock();
+  int i;
+
+  for (i = 0; i < SCAN_PASSES; i++)
+    *stops = scan(set, (const uint8_t *)data, (bufsize_t)len);
+  return cpu_ms(start) / SCAN_PASSES;
+}
+
+// The line end and special character scans over samples with long
+// and with short runs between stops, a byte at a time and with the
+// byte set search, and a parse of the same input for scale.
+static void scans(void) {
+  static const char *const samples[] = {"lorem1.md", "inline-newlines.md"};
+  static const struct {
+    const char *name;
+    const cmark_byteset *set;
+  } sets[] = {{"line ends", &line_end_chars},
+              {"special chars", &special_chars}};
+  cmark_node *doc;
+  clock_t start;
+  char *data;
+  size_t len;
+  long stops, found;
+  double bytes_ms, find_ms;
+  size_t i, j;
+
+  for (i = 0; i < sizeof(samples) / sizeof(*samples); i++) {
+    data = read_sample(samples[i], &len);
+    if (data == NULL) {
+      printf("scan: cannot read %s\n", samples[i]);
+      continue;
+    }
+    for (j = 0; j < sizeof(sets) / sizeof(*sets); j++) {
+      bytes_ms = scan_ms(scan_bytes, sets[j].set, data, len, &stops);
+      find_ms = scan_ms(scan_find, sets[j].set, data, len, &found);
+      printf("scan: %s x%d (%.1f MB), %s: %.2f ms a byte at a time, "
+             "%.2f ms with cmark_byteset_find%s\n",
+             samples[i], SCAN_COPIES, len / 1e6, sets[j].name, bytes_ms,
+             find_ms, stops == found ? "" : " (MISMATCH)");
+    }
+    start = clock();
+    doc = cmark_parse_document(data, len, CMARK_OPT_DEFAULT);
+    printf("scan: %s x%d parsed in %.1f ms\n", samples[i], SCAN_COPIES,
+           cpu_ms(start));
+    cmark_node_free(doc);
+    free(data);
+  }
+}
+#endif
+
+// Parses documents and edits them through the API the way an editor
+// would, then frees them, which exercises the node slab.
+static void node_slab(void) {
+  static const char markdown[] = "# Heading\n\n"
+                                 "Some *emphasis* and **strong** text\n"
+                                 "with a [link](/url) and `code`.\n\n"
+                                 "- one\n- two\n- three\n\n"
+                                 "> quoted *text*\n";
+  cmark_node *doc, *node, *next, *emph, *list;
+  clock_t start;
+  int i, j;
+
+  start = clock();
+  for (i = 0; i < 20000; i++) {
+    doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                               CMARK_OPT_DEFAULT);
+    list = cmark_node_new(CMARK_NODE_LIST);
+    for (j = 0; j < 20; j++) {
+      cmark_node *item = cmark_node_new(CMARK_NODE_ITEM);
+      cmark_node *para = cmark_node_new(CMARK_NODE_PARAGRAPH);
+      cmark_node *text = cmark_node_new(CMARK_NODE_TEXT);
+      cmark_node_set_literal(text, "item");
+      cmark_node_append_child(para, text);
+      cmark_node_append_child(item, para);
+      cmark_node_append_child(list, item);
+    }
+    cmark_node_append_child(doc, list);
+
+    for (node = cmark_node_first_child(doc); node;
+         node = cmark_node_next(node)) {
+      if (cmark_node_get_type(node) != CMARK_NODE_PARAGRAPH)
+        continue;
+      emph = cmark_node_new(CMARK_NODE_EMPH);
+      while (cmark_node_first_child(node))
+        cmark_node_append_child(emph, cmark_node_first_child(node));
+      cmark_node_append_child(node, emph);
+      while (cmark_node_first_child(emph))
+        cmark_node_insert_before(emph, cmark_node_first_child(emph));
+      cmark_node_free(emph);
+    }
+
+    for (node = cmark_node_first_child(list); node; node = next) {
+      next = cmark_node_next(node);
+      if (next)
+        next = cmark_node_next(next);
+      cmark_node_free(node);
+    }
+    cmark_node_free(list);
+    cmark_node_free(doc);
+  }
+  printf("node slab: 20000 build/edit/free cycles in %.1f ms\n",
+         cpu_ms(start));
+}
+
+// Parses many small documents, with a new parser for each and with
+// one parser that is reset in between.
+static void parser_reset(void) {
+  static const char comment[] = "A *short* comment with a [link](/u).\n";
+  size_t len = sizeof(comment) - 1;
+  cmark_parser *parser;
+  cmark_node *doc;
+  clock_t start;
+  int i;
+
+  start = clock();
+  for (i = 0; i < 200000; i++) {
+    doc = cmark_parse_document(comment, len, CMARK_OPT_DEFAULT);
+    cmark_node_free(doc);
+  }
+  printf("parser reset: 200000 small documents in %.1f ms with new parsers",
+         cpu_ms(start));
+
+  parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  start = clock();
+  for (i = 0; i < 200000; i++) {
+    cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+    cmark_parser_feed(parser, comment, len);
+    doc = cmark_parser_finish(parser);
+    cmark_node_free(doc);
+  }
+  printf(", %.1f ms with one\n", cpu_ms(start));
+  cmark_parser_free(parser);
+}
+
+#ifdef HAVE_PTHREADS
+#define BATCH_DOCS 200000
+#define BATCH_MAX_THREADS 8
+
+typedef struct {
+  const char **docs;
+  const size_t *lens;
+  char **out;
+  size_t first;
+  size_t last;
+} naive_job;
+
+static void *naive_thread(void *arg) {
+  naive_job *job = (naive_job *)arg;
+  size_t i;
+
+  for (i = job->first; i < job->last; i++)
+    job->out[i] = cmark_markdown_to_html(job->docs[i], job->lens[i],
+                                         CMARK_OPT_DEFAULT);
+  return NULL;
+}
+
+static double wall_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Documents per second converted by a loop over cmark_markdown_to_html
+// split among threads, and by cmark_markdown_to_html_batch.
+static void batch(void) {
+  static const char comment[] =
+      "A *short* comment with a [link](/u) and `code`.\n\n"
+      "> quoting someone\n\n- a list\n- of things\n";
+  const char **docs = (const char **)malloc(BATCH_DOCS * sizeof(*docs));
+  size_t *lens = (size_t *)malloc(BATCH_DOCS * sizeof(*lens));
+  char **out = (char **)malloc(BATCH_DOCS * sizeof(*out));
+  pthread_t thread_ids[BATCH_MAX_THREADS];
+  naive_job jobs[BATCH_MAX_THREADS];
+  double start, naive_ms, batch_ms;
+  int i, threads;
+
+  for (i = 0; i < BATCH_DOCS; i++) {
+    docs[i] = comment;
+    lens[i] = sizeof(comment) - 1;
+  }
+
+  for (threads = 1; threads <= BATCH_MAX_THREADS; threads *= 2) {
+    start = wall_ms();
+    for (i = 0; i < threads; i++) {
+      jobs[i].docs = docs;
+      jobs[i].lens = lens;
+      jobs[i].out = out;
+      jobs[i].first = (size_t)BATCH_DOCS * i / threads;
+      jobs[i].last = (size_t)BATCH_DOCS * (i + 1) / threads;
+      pthread_create(&thread_ids[i], NULL, naive_thread, &jobs[i]);
+    }
+    for (i = 0; i < threads; i++)
+      pthread_join(thread_ids[i], NULL);
+    naive_ms = wall_ms() - start;
+    for (i = 0; i < BATCH_DOCS; i++)
+      free(out[i]);
+
+    start = wall_ms();
+    cmark_markdown_to_html_batch(docs, lens, BATCH_DOCS, CMARK_OPT_DEFAULT,
+                                 threads, out);
+    batch_ms = wall_ms() - start;
+    for (i = 0; i < BATCH_DOCS; i++)
+      free(out[i]);
+
+    printf("batch: %d thread%s, %.0f docs/s with a loop, %.0f docs/s "
+           "batched\n",
+           threads, threads == 1 ? "" : "s", BATCH_DOCS * 1000 / naive_ms,
+           BATCH_DOCS * 1000 / batch_ms);
+  }
+
+  free(out);
+  free(lens);
+  free((void *)docs);
+}
+#endif
+
+int main(void) {
+#ifdef CMARK_STATIC_DEFINE
+  scans();
+#endif
+  node_slab();
+  parser_reset();
+#ifdef HAVE_PTHREADS
+  batch();
+#endif
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+#include "cmark.h"
+#include "arena.h"
+
+// Bump-pointer arena backing the arena memory allocator.  Every
+// allocation is carved out of the most recent chunk and prefixed
+// with its size, so that realloc can copy the old contents and can
+// grow the most recent allocation in place.  Chunks grow
+// geometrically; cmark_arena_reset keeps the newest (largest) chunk
+// so that a steady stream of similarly sized documents never goes
+// back to malloc.  The state is per thread, given thread-local
+// storage (see CMARK_THREAD_LOCAL).
+
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (16 * 1024 * 1024)
+#define ARENA_ALIGN 8
+// Each allocation is preceded by a header holding its size.
+#define ARENA_HEADER ARENA_ALIGN
+#define ARENA_NEED(sz)                                                         \
+  ((ARENA_HEADER + (sz) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+  struct arena_chunk *prev;
+  size_t size;
+  size_t used;
+  // Keeps the data that follows aligned for any scalar type.
+  union {
+    double d;
+    void *p;
+    size_t s;
+  } align;
+};
+
+static CMARK_THREAD_LOCAL struct arena_chunk *A = NULL;
+
+#define CHUNK_DATA(c) ((unsigned char *)&(c)->align)
+#define ALLOC_SIZE(p) (*(size_t *)((unsigned char *)(p) - ARENA_HEADER))
+
+static void arena_fail(void) {
+  fprintf(stderr, "[cmark] arena allocation failed, aborting\n");
+  abort();
+}
+
+static struct arena_chunk *alloc_arena_chunk(size_t sz,
+                                             struct arena_chunk *prev) {
+  struct arena_chunk *c;
+
+  if (sz > SIZE_MAX - sizeof(struct arena_chunk))
+    arena_fail();
+  c = (struct arena_chunk *)malloc(sizeof(struct arena_chunk) + sz);
+  if (!c)
+    arena_fail();
+  c->prev = prev;
+  c->size = sz;
+  c->used = 0;
+  return c;
+}
+
+static void *arena_alloc(size_t sz) {
+  size_t need;
+  unsigned char *ptr;
+
+  if (sz > SIZE_MAX / 2)
+    arena_fail();
+  need = ARENA_NEED(sz);
+
+  if (!A)
+    A = alloc_arena_chunk(ARENA_MIN_CHUNK, NULL);
+
+  if (A->size - A->used < need) {
+    size_t chunk_size = A->size;
+    if (chunk_size < ARENA_MAX_CHUNK)
+      chunk_size *= 2;
+    if (need > chunk_size / 2) {
+      // Oversized allocations get a chunk of their own, slotted in
+      // behind the current one so that the latter stays in use.
+      struct arena_chunk *big = alloc_arena_chunk(need, A->prev);
+      big->used = need;
+      A->prev = big;
+      ptr = CHUNK_DATA(big);
+      *(size_t *)ptr = sz;
+      return ptr + ARENA_HEADER;
+    }
+    A = alloc_arena_chunk(chunk_size, A);
+  }
+
+  ptr = CHUNK_DATA(A) + A->used;
+  A->used += need;
+  *(size_t *)ptr = sz;
+  return ptr + ARENA_HEADER;
+}
+
+static void *arena_calloc(size_t nmem, size_t size) {
+  void *ptr;
+
+  if (size && nmem > SIZE_MAX / size)
+    arena_fail();
+  ptr = arena_alloc(nmem * size);
+  memset(ptr, 0, nmem * size);
+  return ptr;
+}
+
+static void *arena_realloc(void *ptr, size_t size) {
+  size_t old_size, old_need, need;
+  unsigned char *new_ptr;
+
+  if (!ptr)
+    return arena_alloc(size);
+
+  old_size = ALLOC_SIZE(ptr);
+  if (size <= old_size)
+    return ptr;
+
+  // Extend in place when ptr is the last allocation of the current
+  // chunk, which is the common case for a buffer being appended to.
+  old_need = ARENA_NEED(old_size);
+  need = ARENA_NEED(size);
+  if (A && (unsigned char *)ptr - ARENA_HEADER ==
+               CHUNK_DATA(A) + A->used - old_need &&
+      A->size - A->used >= need - old_need) {
+    A->used += need - old_need;
+    ALLOC_SIZE(ptr) = size;
+    return ptr;
+  }
+
+  new_ptr = (unsigned char *)arena_alloc(size);
+  memcpy(new_ptr, ptr, old_size);
+  return new_ptr;
+}
+
+static void arena_free(void *ptr) { (void)ptr; }
+
+cmark_mem CMARK_ARENA_MEM_ALLOCATOR = {arena_calloc, arena_realloc,
+                                       arena_free};
+
+cmark_mem *cmark_get_arena_mem_allocator(void) {
+  return &CMARK_ARENA_MEM_ALLOCATOR;
+}
+
+void cmark_arena_reset(void) {
+  struct arena_chunk *c;
+
+  if (!A)
+    return;
+
+  // Keep the current chunk around for the next document.
+  c = A->prev;
+  while (c) {
+    struct arena_chunk *prev = c->prev;
+    free(c);
+    c = prev;
+  }
+  A->prev = NULL;
+  A->used = 0;
+}
+
+void cmark_arena_release(void) {
+  cmark_arena_reset();
+  free(A);
+  A = NULL;
+}
@@ -0,0 +1,18 @@
+#ifndef CMARK_ARENA_H
+#define CMARK_ARENA_H
+
+#include "cmark.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The allocator returned by cmark_get_arena_mem_allocator, which
+// callers compare against to tell arena trees apart.  See arena.c.
+extern cmark_mem CMARK_ARENA_MEM_ALLOCATOR;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
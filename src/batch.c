@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "cmark.h"
+#include "thread.h"
+
+// Batch conversion.  Each worker converts documents with a parser
+// allocated from its thread's arena, which is reset after every
+// document, so that once the arena has warmed up a document costs no
+// trips to malloc other than the copy of its HTML handed to the
+// caller.  Setting up a parser in the arena is a handful of pointer
+// bumps, cheaper than resetting one that uses malloc.  Without
+// thread-local storage, though, all threads would share one arena, so
+// workers then reuse a parser of their own that uses malloc.
+//
+// Work is spread by stealing: every worker starts with an equal range
+// of documents and takes them from the front; a worker that runs out
+// takes the back half of the largest remaining range.  A document only
+// ever moves into the range of a running worker, so none is lost when
+// a worker that finds all ranges empty exits.
+
+extern cmark_mem DEFAULT_MEM_ALLOCATOR;
+
+#ifdef CMARK_THREADS
+
+#ifdef HAVE_THREAD_LOCAL
+static char *S_copy_html(const char *html) {
+  size_t len = strlen(html);
+  char *copy = (char *)DEFAULT_MEM_ALLOCATOR.realloc(NULL, len + 1);
+  memcpy(copy, html, len + 1);
+  return copy;
+}
+#endif
+
+typedef struct {
+  cmark_mutex lock;
+  size_t next;
+  size_t end;
+} batch_range;
+
+typedef struct {
+  const char **docs;
+  const size_t *lens;
+  char **out;
+  int options;
+  batch_range *ranges;
+  int nworkers;
+} batch_job;
+
+typedef struct {
+  batch_job *job;
+  int index;
+} batch_worker;
+
+static bool S_take(batch_range *range, size_t *doc) {
+  bool found;
+
+  cmark_mutex_lock(&range->lock);
+  found = range->next < range->end;
+  if (found)
+    *doc = range->next++;
+  cmark_mutex_unlock(&range->lock);
+  return found;
+}
+
+// Moves the back half of the largest other range into the worker's
+// own, which is empty.  Returns false if there was nothing left.
+static bool S_steal(batch_job *job, int self) {
+  batch_range *victim = NULL;
+  size_t most = 0, left, mid;
+  int i;
+
+  for (i = 0; i < job->nworkers; i++) {
+    if (i == self)
+      continue;
+    cmark_mutex_lock(&job->ranges[i].lock);
+    left = job->ranges[i].end - job->ranges[i].next;
+    cmark_mutex_unlock(&job->ranges[i].lock);
+    if (left > most) {
+      most = left;
+      victim = &job->ranges[i];
+    }
+  }
+  if (victim == NULL)
+    return false;
+
+  cmark_mutex_lock(&victim->lock);
+  left = victim->end - victim->next;
+  mid = victim->end - (left + 1) / 2;
+  if (left > 0)
+    victim->end = mid;
+  cmark_mutex_unlock(&victim->lock);
+  if (left == 0)
+    return true; // taken in the meantime; look again
+
+  cmark_mutex_lock(&job->ranges[self].lock);
+  job->ranges[self].next = mid;
+  job->ranges[self].end = mid + (left + 1) / 2;
+  cmark_mutex_unlock(&job->ranges[self].lock);
+  return true;
+}
+
+static CMARK_THREAD_FUNC(batch_thread) {
+  batch_worker *worker = (batch_worker *)arg;
+  batch_job *job = worker->job;
+  cmark_parser *parser;
+  cmark_node *document;
+  size_t doc;
+#ifdef HAVE_THREAD_LOCAL
+  cmark_mem *arena = cmark_get_arena_mem_allocator();
+#else
+  parser = cmark_parser_new(job->options);
+#endif
+
+  for (;;) {
+    if (!S_take(&job->ranges[worker->index], &doc)) {
+      if (!S_steal(job, worker->index))
+        break;
+      continue;
+    }
+#ifdef HAVE_THREAD_LOCAL
+    parser = cmark_parser_new_with_mem(job->options, arena);
+    cmark_parser_feed(parser, job->docs[doc], job->lens[doc]);
+    document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    job->out[doc] = S_copy_html(cmark_render_html(document, job->options));
+    cmark_arena_reset();
+#else
+    cmark_parser_reset(parser, job->options);
+    cmark_parser_feed(parser, job->docs[doc], job->lens[doc]);
+    document = cmark_parser_finish(parser);
+    job->out[doc] = cmark_render_html(document, job->options);
+    cmark_node_free(document);
+#endif
+  }
+
+#ifdef HAVE_THREAD_LOCAL
+  cmark_arena_release();
+#else
+  cmark_parser_free(parser);
+#endif
+  CMARK_THREAD_RETURN;
+}
+
+#endif
+
+void cmark_markdown_to_html_batch(const char **docs, const size_t *lens,
+                                  size_t n, int options, int threads,
+                                  char **out) {
+  cmark_parser *parser;
+  cmark_node *document;
+  size_t doc;
+
+#ifdef CMARK_THREADS
+  cmark_mem *mem = &DEFAULT_MEM_ALLOCATOR;
+  batch_job job;
+  batch_worker *workers;
+  cmark_thread *thread_ids;
+  bool *started;
+  int i, nstarted = 0;
+
+  if (n == 0)
+    return;
+  if (threads < 1)
+    threads = 1;
+  if ((size_t)threads > n)
+    threads = (int)n;
+
+  // The workers run on threads of their own, as the calling thread's
+  // arena may be in use.
+  job.docs = docs;
+  job.lens = lens;
+  job.out = out;
+  job.options = options;
+  job.nworkers = threads;
+  job.ranges = (batch_range *)mem->calloc(threads, sizeof(*job.ranges));
+  workers = (batch_worker *)mem->calloc(threads, sizeof(*workers));
+  thread_ids = (cmark_thread *)mem->calloc(threads, sizeof(*thread_ids));
+  started = (bool *)mem->calloc(threads, sizeof(*started));
+  for (i = 0; i < threads; i++) {
+    cmark_mutex_init(&job.ranges[i].lock);
+    job.ranges[i].next = n / threads * i;
+    job.ranges[i].end = i == threads - 1 ? n : n / threads * (i + 1);
+    workers[i].job = &job;
+    workers[i].index = i;
+  }
+  for (i = 0; i < threads; i++) {
+    started[i] = cmark_thread_create(&thread_ids[i], batch_thread, &workers[i]);
+    nstarted += started[i];
+  }
+  for (i = 0; i < threads; i++) {
+    if (started[i])
+      cmark_thread_join(thread_ids[i]);
+  }
+  for (i = 0; i < threads; i++)
+    cmark_mutex_destroy(&job.ranges[i].lock);
+  mem->free(started);
+  mem->free(thread_ids);
+  mem->free(workers);
+  mem->free(job.ranges);
+
+  // Unless no thread could be started at all, the workers that were
+  // have stolen the ranges of the others.
+  if (nstarted > 0)
+    return;
+#endif
+
+  (void)threads;
+  parser = cmark_parser_new(options);
+  for (doc = 0; doc < n; doc++) {
+    if (doc > 0)
+      cmark_parser_reset(parser, options);
+    cmark_parser_feed(parser, docs[doc], lens[doc]);
+    document = cmark_parser_finish(parser);
+    out[doc] = cmark_render_html(document, options);
+    cmark_node_free(document);
+  }
+  cmark_parser_free(parser);
+}
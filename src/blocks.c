@@ -20,6 +20,9 @@
 #include "inlines.h"
 #include "houdini.h"
 #include "buffer.h"
+#include "simd.h"
+#include "thread.h"
+#include "arena.h"
 
 #define CODE_INDENT 4
 #define TAB_STOP 4
@@ -67,37 +70,32 @@ static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
 static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
                            bufsize_t bytes);
 
-static cmark_node *make_block(cmark_mem *mem, cmark_node_type tag,
+static cmark_node *S_take_document(cmark_parser *parser);
+
+static cmark_node *make_block(cmark_parser *parser, cmark_node_type tag,
                               int start_line, int start_column) {
   cmark_node *e;
 
-  e = (cmark_node *)mem->calloc(1, sizeof(*e));
-  cmark_strbuf_init(mem, &e->content, 32);
+  e = cmark_node_alloc(parser->mem, &parser->node_cache);
   e->type = (uint16_t)tag;
-  e->flags = CMARK_NODE__OPEN;
-  e->start_line = start_line;
-  e->start_column = start_column;
-  e->end_line = start_line;
+  e->flags |= CMARK_NODE__OPEN;
+  cmark_cold(e)->start_line = start_line;
+  cmark_cold(e)->start_column = start_column;
+  cmark_cold(e)->end_line = start_line;
 
   return e;
 }
 
 // Create a root document node.
-static cmark_node *make_document(cmark_mem *mem) {
-  cmark_node *e = make_block(mem, CMARK_NODE_DOCUMENT, 1, 1);
+static cmark_node *make_document(cmark_parser *parser) {
+  cmark_node *e = make_block(parser, CMARK_NODE_DOCUMENT, 1, 1);
   return e;
 }
 
-cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
-  cmark_parser *parser = (cmark_parser *)mem->calloc(1, sizeof(cmark_parser));
-  parser->mem = mem;
-
-  cmark_node *document = make_document(mem);
-
-  cmark_strbuf_init(mem, &parser->curline, 256);
-  cmark_strbuf_init(mem, &parser->linebuf, 0);
+// Sets up the parser for the start of a document.
+static void S_parser_start(cmark_parser *parser, int options) {
+  cmark_node *document = make_document(parser);
 
-  parser->refmap = cmark_reference_map_new(mem);
   parser->root = document;
   parser->current = document;
   parser->line_number = 0;
@@ -109,9 +107,25 @@ cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
   parser->indent = 0;
   parser->blank = false;
   parser->partially_consumed_tab = false;
+  parser->line_length = 0;
   parser->last_line_length = 0;
   parser->options = options;
   parser->last_buffer_ended_with_cr = false;
+}
+
+cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
+  cmark_parser *parser = (cmark_parser *)mem->calloc(1, sizeof(cmark_parser));
+  parser->mem = mem;
+
+  cmark_strbuf_init(mem, &parser->curline, 256);
+  cmark_strbuf_init(mem, &parser->linebuf, 0);
+  cmark_strbuf_init(mem, &parser->content, 0);
+  cmark_strbuf_init(mem, &parser->label_buf, 0);
+
+  parser->refmap = cmark_reference_map_new(mem);
+  parser->inline_pool = cmark_inline_pool_new(mem);
+  parser->threads = 1;
+  S_parser_start(parser, options);
 
   return parser;
 }
@@ -121,20 +135,46 @@ cmark_parser *cmark_parser_new(int options) {
   return cmark_parser_new_with_mem(options, &DEFAULT_MEM_ALLOCATOR);
 }
 
+void cmark_parser_set_threads(cmark_parser *parser, int threads) {
+  parser->threads = threads < 1 ? 1 : threads;
+}
+
+void cmark_parser_reset(cmark_parser *parser, int options) {
+  // A document that was not finished is dropped.
+  if (parser->root)
+    cmark_node_free(parser->root);
+
+  cmark_strbuf_clear(&parser->curline);
+  cmark_strbuf_clear(&parser->linebuf);
+  cmark_strbuf_clear(&parser->content);
+  parser->content_node = NULL;
+  parser->num_pending = 0;
+  parser->pending_size = 0;
+  cmark_reference_map_clear(parser->refmap);
+  S_parser_start(parser, options);
+}
+
 void cmark_parser_free(cmark_parser *parser) {
   cmark_mem *mem = parser->mem;
+  if (parser->root)
+    cmark_node_free(parser->root);
   cmark_strbuf_free(&parser->curline);
   cmark_strbuf_free(&parser->linebuf);
+  cmark_strbuf_free(&parser->content);
+  cmark_strbuf_free(&parser->label_buf);
+  mem->free(parser->pending);
   cmark_reference_map_free(parser->refmap);
+  cmark_inline_pool_free(parser->inline_pool);
+  cmark_node_cache_release(&parser->node_cache);
   mem->free(parser);
 }
 
 static cmark_node *finalize(cmark_parser *parser, cmark_node *b);
 
 // Returns true if line has only space characters, else false.
-static bool is_blank(cmark_strbuf *s, bufsize_t offset) {
-  while (offset < s->size) {
-    switch (s->ptr[offset]) {
+static bool is_blank(cmark_chunk *s, bufsize_t offset) {
+  while (offset < s->len) {
+    switch (s->data[offset]) {
     case '\r':
     case '\n':
       return true;
@@ -171,20 +211,149 @@ static CMARK_INLINE bool contains_inlines(cmark_node_type block_type) {
           block_type == CMARK_NODE_HEADING);
 }
 
+// Long blocks are copied into parser->content in batches of this
+// many spans, which keeps the span array small.
+#define MAX_PENDING 256
+
+// Copies the lines of parser->content_node that still point into the
+// input into parser->content, growing the latter only once.
+static void S_flush_pending(cmark_parser *parser) {
+  cmark_strbuf *content = &parser->content;
+  bufsize_t i;
+
+  if (parser->pending_size > 0) {
+    cmark_strbuf_grow(content, content->size + parser->pending_size);
+    for (i = 0; i < parser->num_pending; i++) {
+      memcpy(content->ptr + content->size, parser->pending[i].data,
+             parser->pending[i].len);
+      content->size += parser->pending[i].len;
+    }
+    content->ptr[content->size] = '\0';
+  }
+
+  parser->num_pending = 0;
+  parser->pending_size = 0;
+}
+
+// With CMARK_OPT_RETAIN_SOURCE, a paragraph or heading whose text is
+// a single span of the input uses that span as its content, so the
+// inline parser reads from (and its text nodes point into) the input.
+// Such content does not own its memory and must not be modified.
+// Paragraphs starting with '[' are copied, since reference definitions
+// are removed from their content.
+static bool S_can_retain(cmark_parser *parser, cmark_node *node) {
+  return (parser->options & CMARK_OPT_RETAIN_SOURCE) &&
+         contains_inlines(S_type(node)) && parser->content.size == 0 &&
+         parser->num_pending == 1 &&
+         !(S_type(node) == CMARK_NODE_PARAGRAPH &&
+           parser->pending[0].data[0] == '[');
+}
+
+// Returns the text of node collected so far, which stays valid until
+// the next line is added.
+static cmark_chunk S_peek_content(cmark_parser *parser, cmark_node *node) {
+  cmark_chunk c = {NULL, 0, 0};
+
+  if (node != parser->content_node)
+    return c;
+  if (!S_can_retain(parser, node))
+    S_flush_pending(parser);
+  if (parser->num_pending > 0)
+    return parser->pending[0];
+  c.data = parser->content.ptr;
+  c.len = parser->content.size;
+  return c;
+}
+
+// Hands the text of a closed block over to it.  The text is copied
+// into an exactly sized buffer, so that parser->content keeps its
+// buffer for the next block.
+static cmark_chunk S_take_content(cmark_parser *parser, cmark_node *node) {
+  cmark_chunk c = S_peek_content(parser, node);
+
+  if (node != parser->content_node)
+    return c;
+
+  if (parser->num_pending == 0) {
+    c.data = (unsigned char *)parser->mem->realloc(NULL, c.len + 1);
+    memcpy(c.data, parser->content.ptr, c.len);
+    c.data[c.len] = '\0';
+    c.alloc = 1;
+  }
+
+  cmark_strbuf_clear(&parser->content);
+  parser->content_node = NULL;
+  parser->num_pending = 0;
+  parser->pending_size = 0;
+  return c;
+}
+
+static void S_add_pending(cmark_parser *parser, const unsigned char *data,
+                          bufsize_t len) {
+  cmark_chunk *last = parser->num_pending > 0
+                          ? &parser->pending[parser->num_pending - 1]
+                          : NULL;
+
+  if (len <= 0)
+    return;
+
+  parser->pending_size += len;
+
+  // Consecutive lines without container markers or indentation are
+  // usually adjacent in the input.
+  if (last && last->data + last->len == data) {
+    last->len += len;
+    return;
+  }
+
+  if (parser->num_pending == parser->pending_alloc) {
+    bufsize_t new_alloc =
+        parser->pending_alloc ? parser->pending_alloc * 2 : 16;
+    parser->pending = (cmark_chunk *)parser->mem->realloc(
+        parser->pending, new_alloc * sizeof(cmark_chunk));
+    parser->pending_alloc = new_alloc;
+  }
+
+  last = &parser->pending[parser->num_pending++];
+  last->data = (unsigned char *)data;
+  last->len = len;
+  last->alloc = 0;
+}
+
+// Lines that are processed in place stay valid for the rest of the
+// call to S_parser_feed, so they are only recorded here and copied
+// into parser->content when it is needed, or when the call ends
+// (never, with CMARK_OPT_RETAIN_SOURCE); see S_flush_pending.
+static void S_add_text(cmark_parser *parser, bool in_place,
+                       const unsigned char *data, bufsize_t len) {
+  if (in_place) {
+    S_add_pending(parser, data, len);
+  } else {
+    S_flush_pending(parser);
+    cmark_strbuf_put(&parser->content, data, len);
+  }
+}
+
+// The text of the open leaf block is collected in parser->content
+// rather than in the node, and handed over when the block is closed
+// (see S_take_content).  Only one such block is open at a time.
 static void add_line(cmark_node *node, cmark_chunk *ch, cmark_parser *parser) {
+  static const unsigned char spaces[] = "    ";
+  bool in_place = ch->data != parser->curline.ptr;
   int chars_to_tab;
-  int i;
   assert(node->flags & CMARK_NODE__OPEN);
+  assert(parser->content_node == NULL || parser->content_node == node);
+  parser->content_node = node;
+  if (parser->num_pending == MAX_PENDING)
+    S_flush_pending(parser);
   if (parser->partially_consumed_tab) {
     parser->offset += 1; // skip over tab
     // add space characters:
     chars_to_tab = TAB_STOP - (parser->column % TAB_STOP);
-    for (i = 0; i < chars_to_tab; i++) {
-      cmark_strbuf_putc(&node->content, ' ');
-    }
+    S_add_text(parser, in_place, spaces, chars_to_tab);
   }
-  cmark_strbuf_put(&node->content, ch->data + parser->offset,
-                   ch->len - parser->offset);
+  S_add_text(parser, in_place, ch->data + parser->offset,
+             ch->len - parser->offset);
 }
 
 static void remove_trailing_blank_lines(cmark_strbuf *ln) {
@@ -234,8 +403,10 @@ static bool resolve_reference_link_definitions(
 		cmark_parser *parser,
                 cmark_node *b) {
   bufsize_t pos;
-  cmark_strbuf *node_content = &b->content;
-  cmark_chunk chunk = {node_content->ptr, node_content->size, 0};
+  cmark_chunk chunk = S_peek_content(parser, b);
+  bufsize_t len = chunk.len;
+  bool has_content;
+
   while (chunk.len && chunk.data[0] == '[' &&
          (pos = cmark_parse_reference_inline(parser->mem, &chunk,
 					     parser->refmap))) {
@@ -243,8 +414,12 @@ static bool resolve_reference_link_definitions(
     chunk.data += pos;
     chunk.len -= pos;
   }
-  cmark_strbuf_drop(node_content, (node_content->size - chunk.len));
-  return !is_blank(&b->content, 0);
+  has_content = !is_blank(&chunk, 0);
+  // Content starting with '[' is never retained, so this is
+  // parser->content.
+  if (chunk.len < len)
+    cmark_strbuf_drop(&parser->content, len - chunk.len);
+  return has_content;
 }
 
 static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
@@ -259,30 +434,29 @@ static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
          CMARK_NODE__OPEN); // shouldn't call finalize on closed blocks
   b->flags &= ~CMARK_NODE__OPEN;
 
-  if (parser->curline.size == 0) {
+  cmark_node_cold *cold = cmark_cold(b);
+  if (parser->line_length == 0) {
     // end of input - line number has not been incremented
-    b->end_line = parser->line_number;
-    b->end_column = parser->last_line_length;
+    cold->end_line = parser->line_number;
+    cold->end_column = parser->last_line_length;
   } else if (S_type(b) == CMARK_NODE_DOCUMENT ||
              (S_type(b) == CMARK_NODE_CODE_BLOCK && b->as.code.fenced) ||
              (S_type(b) == CMARK_NODE_HEADING && b->as.heading.setext)) {
-    b->end_line = parser->line_number;
-    b->end_column = parser->curline.size;
-    if (b->end_column && parser->curline.ptr[b->end_column - 1] == '\n')
-      b->end_column -= 1;
-    if (b->end_column && parser->curline.ptr[b->end_column - 1] == '\r')
-      b->end_column -= 1;
+    cold->end_line = parser->line_number;
+    // lines always end in a single '\n'
+    cold->end_column = parser->line_length - 1;
   } else {
-    b->end_line = parser->line_number - 1;
-    b->end_column = parser->last_line_length;
+    cold->end_line = parser->line_number - 1;
+    cold->end_column = parser->last_line_length;
   }
 
-  cmark_strbuf *node_content = &b->content;
+  cmark_strbuf *node_content = &parser->content;
 
   switch (S_type(b)) {
   case CMARK_NODE_PARAGRAPH:
   {
     has_content = resolve_reference_link_definitions(parser, b);
+    b->as.literal = S_take_content(parser, b);
     if (!has_content) {
       // remove blank node (former reference def)
       cmark_node_free(b);
@@ -290,7 +464,12 @@ static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
     break;
   }
 
+  case CMARK_NODE_HEADING:
+    b->as.heading.content = S_take_content(parser, b);
+    break;
+
   case CMARK_NODE_CODE_BLOCK:
+    S_peek_content(parser, b);
     if (!b->as.code.fenced) { // indented code
       remove_trailing_blank_lines(node_content);
       cmark_strbuf_putc(node_content, '\n');
@@ -314,11 +493,11 @@ static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
         pos += 1;
       cmark_strbuf_drop(node_content, pos);
     }
-    b->as.code.literal = cmark_chunk_buf_detach(node_content);
+    b->as.code.literal = S_take_content(parser, b);
     break;
 
   case CMARK_NODE_HTML_BLOCK:
-    b->as.literal = cmark_chunk_buf_detach(node_content);
+    b->as.literal = S_take_content(parser, b);
     break;
 
   case CMARK_NODE_LIST:      // determine tight/loose status
@@ -369,7 +548,7 @@ static cmark_node *add_child(cmark_parser *parser, cmark_node *parent,
   }
 
   cmark_node *child =
-      make_block(parser->mem, block_type, parser->line_number, start_column);
+      make_block(parser, block_type, parser->line_number, start_column);
   child->parent = parent;
 
   if (parent->last_child) {
@@ -385,9 +564,8 @@ static cmark_node *add_child(cmark_parser *parser, cmark_node *parent,
 
 // Walk through node and all children, recursively, parsing
 // string content into inline content where appropriate.
-static void process_inlines(cmark_mem *mem, cmark_node *root,
-                            cmark_reference_map *refmap, int options) {
-  cmark_iter *iter = cmark_iter_new(root);
+static void process_inlines_serial(cmark_parser *parser) {
+  cmark_iter *iter = cmark_iter_new(parser->root);
   cmark_node *cur;
   cmark_event_type ev_type;
 
@@ -395,7 +573,9 @@ static void process_inlines(cmark_mem *mem, cmark_node *root,
     cur = cmark_iter_get_node(iter);
     if (ev_type == CMARK_EVENT_ENTER) {
       if (contains_inlines(S_type(cur))) {
-        cmark_parse_inlines(mem, cur, refmap, options);
+        cmark_parse_inlines(parser->mem, cur, parser->refmap,
+                            &parser->label_buf, parser->inline_pool,
+                            &parser->node_cache, parser->options);
       }
     }
   }
@@ -403,15 +583,146 @@ static void process_inlines(cmark_mem *mem, cmark_node *root,
   cmark_iter_free(iter);
 }
 
+#ifdef CMARK_THREADS
+
+// Inline content a worker thread should at least have to be worth
+// starting.
+#define INLINE_THREAD_MIN (64 * 1024)
+
+// A run of leaf blocks whose inlines one thread parses.  Each thread
+// has its own delimiter pool, node cache and scratch buffer; the
+// reference map is complete by now and only read.  Nodes come from the
+// parser's allocator, which therefore has to be thread-safe.
+typedef struct {
+  cmark_parser *parser;
+  cmark_node **leaves;
+  size_t count;
+  cmark_inline_pool *pool;
+  cmark_node_cache *nodes;
+  cmark_strbuf *label_buf;
+} inline_run;
+
+static void parse_inline_run(inline_run *run) {
+  size_t i;
+
+  for (i = 0; i < run->count; i++)
+    cmark_parse_inlines(run->parser->mem, run->leaves[i], run->parser->refmap,
+                        run->label_buf, run->pool, run->nodes,
+                        run->parser->options);
+}
+
+static CMARK_THREAD_FUNC(inline_thread) {
+  inline_run *run = (inline_run *)arg;
+  cmark_strbuf label_buf = CMARK_BUF_INIT(run->parser->mem);
+  cmark_node_cache nodes = {NULL, NULL};
+
+  run->pool = cmark_inline_pool_new(run->parser->mem);
+  run->nodes = &nodes;
+  run->label_buf = &label_buf;
+  parse_inline_run(run);
+  cmark_inline_pool_free(run->pool);
+  cmark_node_cache_release(&nodes);
+  cmark_strbuf_free(&label_buf);
+  CMARK_THREAD_RETURN;
+}
+
+// Parses the inlines of the leaf blocks in runs of about equal size on
+// up to parser->threads threads, the calling thread included.  Which
+// thread parses a block does not change its inlines, so the tree is
+// the same as with process_inlines_serial.
+static void process_inlines_parallel(cmark_parser *parser) {
+  cmark_mem *mem = parser->mem;
+  cmark_iter *iter = cmark_iter_new(parser->root);
+  cmark_event_type ev_type;
+  cmark_node **leaves = NULL;
+  size_t count = 0, alloc = 0, total = 0, share, size, i;
+  inline_run *runs;
+  cmark_thread *threads;
+  bool *started;
+  int nruns, r;
+
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cmark_node *cur = cmark_iter_get_node(iter);
+    if (ev_type == CMARK_EVENT_ENTER && contains_inlines(S_type(cur))) {
+      if (count == alloc) {
+        alloc = alloc ? 2 * alloc : 256;
+        leaves = (cmark_node **)mem->realloc(leaves, alloc * sizeof(*leaves));
+      }
+      leaves[count++] = cur;
+      total += (size_t)cmark_node_content(cur)->len;
+    }
+  }
+  cmark_iter_free(iter);
+
+  nruns = parser->threads;
+  if (total / INLINE_THREAD_MIN < (size_t)nruns)
+    nruns = (int)(total / INLINE_THREAD_MIN);
+  if (nruns < 1)
+    nruns = 1;
+
+  runs = (inline_run *)mem->calloc(nruns, sizeof(*runs));
+  threads = (cmark_thread *)mem->calloc(nruns, sizeof(*threads));
+  started = (bool *)mem->calloc(nruns, sizeof(*started));
+
+  // Cut the leaves into runs of about total / nruns bytes each.
+  share = total / nruns + 1;
+  for (i = 0, r = 0; r < nruns; r++) {
+    runs[r].parser = parser;
+    runs[r].leaves = leaves + i;
+    for (size = 0; i < count && (size < share || r == nruns - 1); i++) {
+      size += (size_t)cmark_node_content(leaves[i])->len;
+      runs[r].count++;
+    }
+  }
+
+  for (r = 1; r < nruns; r++)
+    started[r] = cmark_thread_create(&threads[r], inline_thread, &runs[r]);
+
+  runs[0].pool = parser->inline_pool;
+  runs[0].nodes = &parser->node_cache;
+  runs[0].label_buf = &parser->label_buf;
+  parse_inline_run(&runs[0]);
+
+  for (r = 1; r < nruns; r++) {
+    if (started[r]) {
+      cmark_thread_join(threads[r]);
+    } else {
+      // No thread to be had; do it here.
+      runs[r].pool = parser->inline_pool;
+      runs[r].nodes = &parser->node_cache;
+      runs[r].label_buf = &parser->label_buf;
+      parse_inline_run(&runs[r]);
+    }
+  }
+
+  mem->free(started);
+  mem->free(threads);
+  mem->free(runs);
+  mem->free(leaves);
+}
+
+#endif
+
+static void process_inlines(cmark_parser *parser) {
+#ifdef CMARK_THREADS
+  // The arena is per thread, so its nodes can only come from this one.
+  if (parser->threads > 1 && parser->mem != &CMARK_ARENA_MEM_ALLOCATOR) {
+    process_inlines_parallel(parser);
+    return;
+  }
+#endif
+  process_inlines_serial(parser);
+}
+
 // Attempts to parse a list item marker (bullet or enumerated).
 // On success, returns length of the marker, and populates
-// data with the details.  On failure, returns 0.
-static bufsize_t parse_list_marker(cmark_mem *mem, cmark_chunk *input,
-                                   bufsize_t pos, bool interrupts_paragraph,
-                                   cmark_list **dataptr) {
+// data with the details.  On failure, returns 0 and leaves data
+// untouched.
+static bufsize_t parse_list_marker(cmark_chunk *input, bufsize_t pos,
+                                   bool interrupts_paragraph,
+                                   cmark_list *data) {
   unsigned char c;
   bufsize_t startpos;
-  cmark_list *data;
   bufsize_t i;
 
   startpos = pos;
@@ -434,8 +745,8 @@ static bufsize_t parse_list_marker(cmark_mem *mem, cmark_chunk *input,
       }
     }
 
-    data = (cmark_list *)mem->calloc(1, sizeof(*data));
     data->marker_offset = 0; // will be adjusted later
+    data->padding = 0;       // likewise
     data->list_type = CMARK_BULLET_LIST;
     data->bullet_char = c;
     data->start = 0;
@@ -474,8 +785,8 @@ static bufsize_t parse_list_marker(cmark_mem *mem, cmark_chunk *input,
         }
       }
 
-      data = (cmark_list *)mem->calloc(1, sizeof(*data));
       data->marker_offset = 0; // will be adjusted later
+      data->padding = 0;       // likewise
       data->list_type = CMARK_ORDERED_LIST;
       data->bullet_char = 0;
       data->start = start;
@@ -488,7 +799,6 @@ static bufsize_t parse_list_marker(cmark_mem *mem, cmark_chunk *input,
     return 0;
   }
 
-  *dataptr = data;
   return (pos - startpos);
 }
 
@@ -500,23 +810,31 @@ static int lists_match(cmark_list *list_data, cmark_list *item_data) {
           list_data->bullet_char == item_data->bullet_char);
 }
 
-static cmark_node *finalize_document(cmark_parser *parser) {
+static void finalize_blocks(cmark_parser *parser) {
   while (parser->current != parser->root) {
     parser->current = finalize(parser, parser->current);
   }
 
   finalize(parser, parser->root);
-  process_inlines(parser->mem, parser->root, parser->refmap, parser->options);
+}
+
+static cmark_node *finalize_document(cmark_parser *parser) {
+  finalize_blocks(parser);
+  process_inlines(parser);
 
   return parser->root;
 }
 
 cmark_node *cmark_parse_file(FILE *f, int options) {
   unsigned char buffer[4096];
-  cmark_parser *parser = cmark_parser_new(options);
+  cmark_parser *parser;
   size_t bytes;
   cmark_node *document;
 
+  // The buffer is reused for every read, so the text can't point into
+  // it.
+  parser = cmark_parser_new(options & ~CMARK_OPT_RETAIN_SOURCE);
+
   while ((bytes = fread(buffer, 1, sizeof(buffer), f)) > 0) {
     bool eof = bytes < sizeof(buffer);
     S_parser_feed(parser, buffer, bytes, eof);
@@ -541,15 +859,304 @@ cmark_node *cmark_parse_document(const char *buffer, size_t len, int options) {
   return document;
 }
 
+#ifdef CMARK_THREADS
+
+// Input a block parsing thread should at least get.
+#define BLOCK_THREAD_MIN (128 * 1024)
+
+// A piece of the input that is block parsed on its own, as if it
+// were a document of its own.
+typedef struct {
+  cmark_parser *parser;
+  const unsigned char *data;
+  size_t len;
+  bool eof;
+  // Lines before the piece.
+  int base;
+} block_piece;
+
+static void parse_piece(block_piece *piece) {
+  S_parser_feed(piece->parser, piece->data, piece->len, piece->eof);
+}
+
+static CMARK_THREAD_FUNC(block_thread) {
+  parse_piece((block_piece *)arg);
+  CMARK_THREAD_RETURN;
+}
+
+// Returns true if a piece may start at p: p starts with a letter or
+// '#' and follows a blank line, which follows a line starting with a
+// letter.  All blocks but the document are usually closed there, but
+// not always (think of fenced code); this is checked once the piece
+// before is parsed.
+static bool S_is_piece_start(const unsigned char *data, size_t p) {
+  size_t q = p - 1;
+
+  if (!(cmark_isalpha(data[p]) || data[p] == '#'))
+    return false;
+
+  // The blank line.
+  if (q > 0 && data[q - 1] == '\r')
+    q--;
+  while (q > 0 && S_is_space_or_tab(data[q - 1]))
+    q--;
+  if (q < 2 || !S_is_line_end_char(data[q - 1]))
+    return false;
+  q--;
+
+  // The line before.
+  if (data[q] == '\n' && data[q - 1] == '\r')
+    q--;
+  while (q > 0 && !S_is_line_end_char(data[q - 1]))
+    q--;
+  return cmark_isalpha(data[q]);
+}
+
+// Returns the start of the first line in [from, to) that starts with
+// a code fence, or to.  Sets opener if there is none or if it has an
+// info string, that is, if it most likely opens a fenced code block.
+static size_t S_next_fence(const unsigned char *data, size_t from, size_t to,
+                           bool *opener) {
+  const unsigned char *nl;
+  size_t i;
+
+  while (from < to) {
+    if ((data[from] == '`' || data[from] == '~') && to - from >= 3 &&
+        data[from + 1] == data[from] && data[from + 2] == data[from]) {
+      for (i = from + 3; i < to && data[i] == data[from]; i++)
+        ;
+      while (i < to && S_is_space_or_tab(data[i]))
+        i++;
+      *opener = i < to && !S_is_line_end_char(data[i]);
+      return from;
+    }
+    nl = (const unsigned char *)memchr(data + from, '\n', to - from);
+    if (nl == NULL)
+      break;
+    from = (size_t)(nl - data) + 1;
+  }
+  *opener = true;
+  return to;
+}
+
+// Returns a piece start after a line ending in [from, to), or 0.
+// Starts followed by a closing code fence are passed over, unless
+// there are no others.
+static size_t S_find_piece_start(const unsigned char *data, size_t from,
+                                 size_t to) {
+  const unsigned char *nl;
+  size_t fence = 0, first = 0;
+  bool opener = true;
+
+  while (from < to) {
+    nl = (const unsigned char *)memchr(data + from, '\n', to - from);
+    if (nl == NULL)
+      break;
+    from = (size_t)(nl - data) + 1;
+    if (from < to && S_is_piece_start(data, from)) {
+      if (fence < from)
+        fence = S_next_fence(data, from, to, &opener);
+      if (opener)
+        return from;
+      if (first == 0)
+        first = from;
+    }
+  }
+  return first;
+}
+
+// Moves the blocks of the document src to the end of the document
+// dst, shifting their lines by base.
+static void S_move_blocks(cmark_node *dst, cmark_node *src, int base) {
+  cmark_iter *iter = cmark_iter_new(src);
+  cmark_event_type ev_type;
+  cmark_node *cur;
+
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    if (ev_type == CMARK_EVENT_ENTER && cur != src) {
+      cmark_cold(cur)->start_line += base;
+      cmark_cold(cur)->end_line += base;
+    }
+  }
+  cmark_iter_free(iter);
+
+  if (src->first_child == NULL)
+    return;
+  for (cur = src->first_child; cur; cur = cur->next)
+    cur->parent = dst;
+  if (dst->last_child) {
+    dst->last_child->next = src->first_child;
+    src->first_child->prev = dst->last_child;
+  } else {
+    dst->first_child = src->first_child;
+  }
+  dst->last_child = src->last_child;
+  src->first_child = src->last_child = NULL;
+}
+
+// Block parses the input in up to `threads` pieces at once, then
+// stitches the pieces together.  A piece is only used if the parser
+// of the piece before it ended up with just the document open, that
+// is, in the state a fresh parser starts in.  Otherwise that parser
+// goes on to parse the piece itself.  Either way the result is what
+// a single parser would have produced.  Returns NULL if the input is
+// too small to split.
+static cmark_node *S_parse_pieces(const unsigned char *data, size_t len,
+                                  int options, int threads) {
+  extern cmark_mem DEFAULT_MEM_ALLOCATOR;
+  cmark_mem *mem = &DEFAULT_MEM_ALLOCATOR;
+  block_piece *pieces;
+  cmark_thread *thread_ids;
+  bool *started;
+  cmark_parser *parser;
+  cmark_node *document;
+  size_t start = 0, next, share;
+  int max = threads, npieces = 0, last = 0, k;
+
+  if (len / BLOCK_THREAD_MIN < (size_t)max)
+    max = (int)(len / BLOCK_THREAD_MIN);
+  if (max < 2)
+    return NULL;
+
+  pieces = (block_piece *)mem->calloc(max, sizeof(*pieces));
+  share = len / max;
+  for (k = 1; k < max; k++) {
+    next = S_find_piece_start(data, share * k, share * (k + 1));
+    if (next == 0)
+      continue;
+    pieces[npieces].data = data + start;
+    pieces[npieces].len = next - start;
+    npieces++;
+    start = next;
+  }
+  pieces[npieces].data = data + start;
+  pieces[npieces].len = len - start;
+  pieces[npieces].eof = true;
+  npieces++;
+
+  if (npieces < 2) {
+    mem->free(pieces);
+    return NULL;
+  }
+
+  thread_ids = (cmark_thread *)mem->calloc(npieces, sizeof(*thread_ids));
+  started = (bool *)mem->calloc(npieces, sizeof(*started));
+  for (k = 0; k < npieces; k++)
+    pieces[k].parser = cmark_parser_new_with_mem(options, mem);
+  for (k = 1; k < npieces; k++)
+    started[k] = cmark_thread_create(&thread_ids[k], block_thread, &pieces[k]);
+  parse_piece(&pieces[0]);
+  for (k = 1; k < npieces; k++) {
+    if (started[k])
+      cmark_thread_join(thread_ids[k]);
+    else
+      parse_piece(&pieces[k]);
+  }
+
+  for (k = 1; k < npieces; k++) {
+    parser = pieces[last].parser;
+    if (parser->current == parser->root) {
+      pieces[k].base = pieces[last].base + parser->line_number;
+      last = k;
+    } else {
+      cmark_parser_free(pieces[k].parser);
+      pieces[k].parser = parser;
+      parse_piece(&pieces[k]);
+      pieces[k].parser = NULL;
+    }
+  }
+
+  parser = pieces[last].parser;
+  if (parser->linebuf.size) {
+    S_process_line(parser, parser->linebuf.ptr, parser->linebuf.size);
+    cmark_strbuf_clear(&parser->linebuf);
+  }
+  finalize_blocks(parser);
+
+  parser = pieces[0].parser;
+  document = parser->root;
+  for (k = 1; k < npieces; k++) {
+    if (pieces[k].parser == NULL)
+      continue;
+    S_move_blocks(document, pieces[k].parser->root, pieces[k].base);
+    cmark_reference_map_merge(parser->refmap, pieces[k].parser->refmap);
+  }
+  if (last > 0) {
+    cmark_node_cold *cold = cmark_cold(pieces[last].parser->root);
+    cmark_cold(document)->end_line = cold->end_line + pieces[last].base;
+    cmark_cold(document)->end_column = cold->end_column;
+    document->flags &= ~CMARK_NODE__OPEN;
+  }
+
+  cmark_parser_set_threads(parser, threads);
+  process_inlines(parser);
+  document = S_take_document(parser);
+
+  for (k = 0; k < npieces; k++) {
+    if (pieces[k].parser)
+      cmark_parser_free(pieces[k].parser);
+  }
+  mem->free(started);
+  mem->free(thread_ids);
+  mem->free(pieces);
+  return document;
+}
+
+#endif
+
+cmark_node *cmark_parse_document_parallel(const char *buffer, size_t len,
+                                          int options, int threads) {
+  cmark_parser *parser;
+  cmark_node *document;
+
+#ifdef CMARK_THREADS
+  document = S_parse_pieces((const unsigned char *)buffer, len, options,
+                            threads);
+  if (document)
+    return document;
+#endif
+
+  parser = cmark_parser_new(options);
+  cmark_parser_set_threads(parser, threads);
+  S_parser_feed(parser, (const unsigned char *)buffer, len, true);
+  document = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  return document;
+}
+
 void cmark_parser_feed(cmark_parser *parser, const char *buffer, size_t len) {
   S_parser_feed(parser, (const unsigned char *)buffer, len, false);
 }
 
+// Returns a pointer to the first CR, LF or NUL in [p, end), or end.
+static const unsigned char *S_find_line_end(const unsigned char *p,
+                                            const unsigned char *end) {
+#define LINE_END(n)                                                            \
+  CMARK_BYTESET_NIB('\r', n) | CMARK_BYTESET_NIB('\n', n) |                    \
+      CMARK_BYTESET_NIB('\0', n)
+  static const cmark_byteset LINE_END_CHARS = CMARK_BYTESET(LINE_END, false);
+#undef LINE_END
+
+  while (end - p > INT32_MAX) {
+    bufsize_t n = cmark_byteset_find(&LINE_END_CHARS, p, INT32_MAX);
+    if (n < INT32_MAX)
+      return p + n;
+    p += INT32_MAX;
+  }
+
+  return p + cmark_byteset_find(&LINE_END_CHARS, p, (bufsize_t)(end - p));
+}
+
 static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
                           size_t len, bool eof) {
   const unsigned char *end = buffer + len;
   static const uint8_t repl[] = {239, 191, 189};
 
+  // Fed after finishing: start over with a new document.
+  if (parser->root == NULL)
+    cmark_parser_reset(parser, parser->options);
+
   if (parser->last_buffer_ended_with_cr && *buffer == '\n') {
     // skip NL if last buffer ended with CR ; see #117
     buffer++;
@@ -557,29 +1164,26 @@ static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
   parser->last_buffer_ended_with_cr = false;
   while (buffer < end) {
     const unsigned char *eol;
-    bufsize_t chunk_len;
-    bool process = false;
-    for (eol = buffer; eol < end; ++eol) {
-      if (S_is_line_end_char(*eol)) {
-        process = true;
-        break;
-      }
-      if (*eol == '\0' && eol < end) {
-        break;
-      }
-    }
+    bufsize_t chunk_len, line_len;
+    bool process;
+
+    eol = S_find_line_end(buffer, end);
+    process = eol < end && *eol != '\0';
     if (eol >= end && eof) {
       process = true;
     }
 
     chunk_len = (eol - buffer);
     if (process) {
+      // Pass a LF line ending along, so that the line can be processed
+      // without copying it.
+      line_len = chunk_len + (eol < end && *eol == '\n');
       if (parser->linebuf.size > 0) {
-        cmark_strbuf_put(&parser->linebuf, buffer, chunk_len);
+        cmark_strbuf_put(&parser->linebuf, buffer, line_len);
         S_process_line(parser, parser->linebuf.ptr, parser->linebuf.size);
         cmark_strbuf_clear(&parser->linebuf);
       } else {
-        S_process_line(parser, buffer, chunk_len);
+        S_process_line(parser, buffer, line_len);
       }
     } else {
       if (eol < end && *eol == '\0') {
@@ -609,6 +1213,25 @@ static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
       }
     }
   }
+
+  // Unless the caller keeps it alive, the buffer is only valid during
+  // this call.
+  if (!(parser->options & CMARK_OPT_RETAIN_SOURCE))
+    S_flush_pending(parser);
+}
+
+// The scanners temporarily write a NUL after the end of the line (see
+// _scan_at), so a line that is processed in place, and thus points
+// into the caller's buffer, is scanned in a copy in curline.
+static cmark_chunk *S_scannable(cmark_parser *parser, cmark_chunk *input) {
+  if (input->data == parser->curline.ptr)
+    return input;
+  if (parser->curline.size == 0)
+    cmark_strbuf_put(&parser->curline, input->data, input->len);
+  parser->scanline.data = parser->curline.ptr;
+  parser->scanline.len = input->len;
+  parser->scanline.alloc = 0;
+  return &parser->scanline;
 }
 
 static void chop_trailing_hashtags(cmark_chunk *ch) {
@@ -669,6 +1292,17 @@ static void S_find_first_nonspace(cmark_parser *parser, cmark_chunk *input) {
   char c;
   int chars_to_tab = TAB_STOP - (parser->column % TAB_STOP);
 
+  // An ATX heading without content consumes the whole line, newline
+  // included.  Lines processed in place are not NUL-terminated, so
+  // stop there instead of reading past the end.
+  if (parser->offset >= input->len) {
+    parser->first_nonspace = parser->offset;
+    parser->first_nonspace_column = parser->column;
+    parser->indent = 0;
+    parser->blank = false;
+    return;
+  }
+
   if (parser->first_nonspace <= parser->offset) {
     parser->first_nonspace = parser->offset;
     parser->first_nonspace_column = parser->column;
@@ -796,7 +1430,8 @@ static bool parse_code_block_prefix(cmark_parser *parser, cmark_chunk *input,
 
     if (parser->indent <= 3 && (peek_at(input, parser->first_nonspace) ==
                                 container->as.code.fence_char)) {
-      matched = scan_close_code_fence(input, parser->first_nonspace);
+      matched = scan_close_code_fence(S_scannable(parser, input),
+                                      parser->first_nonspace);
     }
 
     if (matched >= container->as.code.fence_length) {
@@ -911,11 +1546,12 @@ done:
 static void open_new_blocks(cmark_parser *parser, cmark_node **container,
                             cmark_chunk *input, bool all_matched) {
   bool indented;
-  cmark_list *data = NULL;
+  cmark_list data;
   bool maybe_lazy = S_type(parser->current) == CMARK_NODE_PARAGRAPH;
   cmark_node_type cont_type = S_type(*container);
   bufsize_t matched = 0;
   int lev = 0;
+  unsigned char c;
   bool save_partially_consumed_tab;
   bool has_content;
   int save_offset;
@@ -926,8 +1562,9 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
 
     S_find_first_nonspace(parser, input);
     indented = parser->indent >= CODE_INDENT;
+    c = peek_at(input, parser->first_nonspace);
 
-    if (!indented && peek_at(input, parser->first_nonspace) == '>') {
+    if (!indented && c == '>') {
 
       bufsize_t blockquote_startpos = parser->first_nonspace;
 
@@ -940,8 +1577,9 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
       *container = add_child(parser, *container, CMARK_NODE_BLOCK_QUOTE,
                              blockquote_startpos + 1);
 
-    } else if (!indented && (matched = scan_atx_heading_start(
-                                 input, parser->first_nonspace))) {
+    } else if (!indented && c == '#' &&
+               (matched = scan_atx_heading_start(S_scannable(parser, input),
+                                                 parser->first_nonspace))) {
       bufsize_t hashpos;
       int level = 0;
       bufsize_t heading_startpos = parser->first_nonspace;
@@ -963,8 +1601,9 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
       (*container)->as.heading.setext = false;
       (*container)->internal_offset = matched;
 
-    } else if (!indented && (matched = scan_open_code_fence(
-                                 input, parser->first_nonspace))) {
+    } else if (!indented && (c == '`' || c == '~') &&
+               (matched = scan_open_code_fence(S_scannable(parser, input),
+                                               parser->first_nonspace))) {
       *container = add_child(parser, *container, CMARK_NODE_CODE_BLOCK,
                              parser->first_nonspace + 1);
       (*container)->as.code.fenced = true;
@@ -977,19 +1616,21 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
                        parser->first_nonspace + matched - parser->offset,
                        false);
 
-    } else if (!indented && ((matched = scan_html_block_start(
-                                  input, parser->first_nonspace)) ||
-                             (cont_type != CMARK_NODE_PARAGRAPH &&
-                              (matched = scan_html_block_start_7(
-                                   input, parser->first_nonspace))))) {
+    } else if (!indented && c == '<' &&
+               ((matched = scan_html_block_start(S_scannable(parser, input),
+                                                 parser->first_nonspace)) ||
+                (cont_type != CMARK_NODE_PARAGRAPH &&
+                 (matched = scan_html_block_start_7(
+                      S_scannable(parser, input), parser->first_nonspace))))) {
       *container = add_child(parser, *container, CMARK_NODE_HTML_BLOCK,
                              parser->first_nonspace + 1);
       (*container)->as.html_block_type = matched;
       // note, we don't adjust parser->offset because the tag is part of the
       // text
     } else if (!indented && cont_type == CMARK_NODE_PARAGRAPH &&
-               (lev =
-                    scan_setext_heading_line(input, parser->first_nonspace))) {
+               (c == '=' || c == '-') &&
+               (lev = scan_setext_heading_line(S_scannable(parser, input),
+                                               parser->first_nonspace))) {
       // finalize paragraph, resolving reference links
       has_content = resolve_reference_link_definitions(parser, *container);
 
@@ -1011,7 +1652,7 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
     } else if ((!indented || cont_type == CMARK_NODE_LIST) &&
 	       parser->indent < 4 &&
                (matched = parse_list_marker(
-                    parser->mem, input, parser->first_nonspace,
+                    input, parser->first_nonspace,
                     (*container)->type == CMARK_NODE_PARAGRAPH, &data))) {
 
       // Note that we can have new list items starting with >= 4
@@ -1036,7 +1677,7 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
       if (i >= 5 || i < 1 ||
           // only spaces after list marker:
           S_is_line_end_char(peek_at(input, parser->offset))) {
-        data->padding = matched + 1;
+        data.padding = matched + 1;
         parser->offset = save_offset;
         parser->column = save_column;
         parser->partially_consumed_tab = save_partially_consumed_tab;
@@ -1044,28 +1685,26 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
           S_advance_offset(parser, input, 1, true);
         }
       } else {
-        data->padding = matched + i;
+        data.padding = matched + i;
       }
 
       // check container; if it's a list, see if this list item
       // can continue the list; otherwise, create a list container.
 
-      data->marker_offset = parser->indent;
+      data.marker_offset = parser->indent;
 
       if (cont_type != CMARK_NODE_LIST ||
-          !lists_match(&((*container)->as.list), data)) {
+          !lists_match(&((*container)->as.list), &data)) {
         *container = add_child(parser, *container, CMARK_NODE_LIST,
                                parser->first_nonspace + 1);
 
-        memcpy(&((*container)->as.list), data, sizeof(*data));
+        (*container)->as.list = data;
       }
 
       // add the list item
       *container = add_child(parser, *container, CMARK_NODE_ITEM,
                              parser->first_nonspace + 1);
-      /* TODO: static */
-      memcpy(&((*container)->as.list), data, sizeof(*data));
-      parser->mem->free(data);
+      (*container)->as.list = data;
     } else if (indented && !maybe_lazy && !parser->blank) {
       S_advance_offset(parser, input, CODE_INDENT, true);
       *container = add_child(parser, *container, CMARK_NODE_CODE_BLOCK,
@@ -1112,7 +1751,7 @@ static void add_text_to_container(cmark_parser *parser, cmark_node *container,
        ctype != CMARK_NODE_HEADING && ctype != CMARK_NODE_THEMATIC_BREAK &&
        !(ctype == CMARK_NODE_CODE_BLOCK && container->as.code.fenced) &&
        !(ctype == CMARK_NODE_ITEM && container->first_child == NULL &&
-         container->start_line == parser->line_number));
+         cmark_cold(container)->start_line == parser->line_number));
 
   S_set_last_line_blank(container, last_line_blank);
 
@@ -1145,31 +1784,32 @@ static void add_text_to_container(cmark_parser *parser, cmark_node *container,
       add_line(container, input, parser);
 
       int matches_end_condition;
+      cmark_chunk *line = S_scannable(parser, input);
       switch (container->as.html_block_type) {
       case 1:
         // </script>, </style>, </pre>
         matches_end_condition =
-            scan_html_block_end_1(input, parser->first_nonspace);
+            scan_html_block_end_1(line, parser->first_nonspace);
         break;
       case 2:
         // -->
         matches_end_condition =
-            scan_html_block_end_2(input, parser->first_nonspace);
+            scan_html_block_end_2(line, parser->first_nonspace);
         break;
       case 3:
         // ?>
         matches_end_condition =
-            scan_html_block_end_3(input, parser->first_nonspace);
+            scan_html_block_end_3(line, parser->first_nonspace);
         break;
       case 4:
         // >
         matches_end_condition =
-            scan_html_block_end_4(input, parser->first_nonspace);
+            scan_html_block_end_4(line, parser->first_nonspace);
         break;
       case 5:
         // ]]>
         matches_end_condition =
-            scan_html_block_end_5(input, parser->first_nonspace);
+            scan_html_block_end_5(line, parser->first_nonspace);
         break;
       default:
         matches_end_condition = 0;
@@ -1211,16 +1851,29 @@ static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
   cmark_node *container;
   cmark_chunk input;
 
-  if (parser->options & CMARK_OPT_VALIDATE_UTF8)
-    cmark_utf8proc_check(&parser->curline, buffer, bytes);
-  else
-    cmark_strbuf_put(&parser->curline, buffer, bytes);
+  if (!(parser->options & CMARK_OPT_VALIDATE_UTF8) && bytes > 0 &&
+      buffer[bytes - 1] == '\n' && buffer != parser->linebuf.ptr) {
+    // Process the line in place; it is only copied into curline if
+    // one of the scanners needs to look at it (see S_scannable).
+    input.data = (unsigned char *)buffer;
+    input.len = bytes;
+  } else {
+    if (parser->options & CMARK_OPT_VALIDATE_UTF8)
+      cmark_utf8proc_check(&parser->curline, buffer, bytes);
+    else
+      cmark_strbuf_put(&parser->curline, buffer, bytes);
+
+    bytes = parser->curline.size;
 
-  bytes = parser->curline.size;
+    // ensure line ends with a newline:
+    if (bytes == 0 || !S_is_line_end_char(parser->curline.ptr[bytes - 1]))
+      cmark_strbuf_putc(&parser->curline, '\n');
 
-  // ensure line ends with a newline:
-  if (bytes == 0 || !S_is_line_end_char(parser->curline.ptr[bytes - 1]))
-    cmark_strbuf_putc(&parser->curline, '\n');
+    input.data = parser->curline.ptr;
+    input.len = parser->curline.size;
+  }
+  input.alloc = 0;
+  parser->line_length = input.len;
 
   parser->offset = 0;
   parser->column = 0;
@@ -1231,10 +1884,6 @@ static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
   parser->blank = false;
   parser->partially_consumed_tab = false;
 
-  input.data = parser->curline.ptr;
-  input.len = parser->curline.size;
-  input.alloc = 0;
-
   parser->line_number++;
 
   last_matched_container = check_open_blocks(parser, &input, &all_matched);
@@ -1257,25 +1906,39 @@ finished:
       input.data[parser->last_line_length - 1] == '\r')
     parser->last_line_length -= 1;
 
+  parser->line_length = 0;
   cmark_strbuf_clear(&parser->curline);
 }
 
-cmark_node *cmark_parser_finish(cmark_parser *parser) {
-  if (parser->linebuf.size) {
-    S_process_line(parser, parser->linebuf.ptr, parser->linebuf.size);
-    cmark_strbuf_clear(&parser->linebuf);
-  }
-
-  finalize_document(parser);
+// Hands the parsed document over to the caller.
+static cmark_node *S_take_document(cmark_parser *parser) {
+  cmark_node *document;
 
   cmark_consolidate_text_nodes(parser->root);
 
-  cmark_strbuf_free(&parser->curline);
-
 #if CMARK_DEBUG_NODES
   if (cmark_node_check(parser->root, stderr)) {
     abort();
   }
 #endif
-  return parser->root;
+
+  document = parser->root;
+  parser->root = NULL;
+  parser->current = NULL;
+  return document;
+}
+
+cmark_node *cmark_parser_finish(cmark_parser *parser) {
+  // The document was handed over already.
+  if (parser->root == NULL)
+    return NULL;
+
+  if (parser->linebuf.size) {
+    S_process_line(parser, parser->linebuf.ptr, parser->linebuf.size);
+    cmark_strbuf_clear(&parser->linebuf);
+  }
+
+  finalize_document(parser);
+
+  return S_take_document(parser);
 }
@@ -65,7 +65,8 @@ void cmark_strbuf_free(cmark_strbuf *buf) {
   if (!buf)
     return;
 
-  if (buf->ptr != cmark_strbuf__initbuf)
+  // A buffer with asize 0 does not own ptr.
+  if (buf->asize > 0)
     buf->mem->free(buf->ptr);
 
   cmark_strbuf_init(buf->mem, buf, 0);
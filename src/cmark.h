@@ -27,6 +27,19 @@ extern "C" {
 CMARK_EXPORT
 char *cmark_markdown_to_html(const char *text, size_t len, int options);
 
+/** Convert the 'n' documents 'docs', with lengths 'lens', to HTML as
+ * `cmark_markdown_to_html` would, storing the result for `docs[i]` in
+ * `out[i]`; the caller frees each with `free`.  The documents are
+ * shared out among up to 'threads' worker threads, each of which parses
+ * in its own arena (see `cmark_get_arena_mem_allocator`).  Without
+ * thread support they are converted one after another on the calling
+ * thread.
+ */
+CMARK_EXPORT
+void cmark_markdown_to_html_batch(const char **docs, const size_t *lens,
+                                  size_t n, int options, int threads,
+                                  char **out);
+
 /** ## Node Structure
  */
 
@@ -92,7 +105,11 @@ typedef struct cmark_iter cmark_iter;
  */
 
 /** Defines the memory allocation functions to be used by CMark
- * when parsing and allocating a document tree
+ * when parsing and allocating a document tree.  Nodes are not
+ * allocated one by one but in chunks of several kilobytes, shared by
+ * allocators with the same `calloc` and `free`.  The slots of freed
+ * nodes are reused for new ones, and a chunk is freed along with the
+ * last of its nodes.
  */
 typedef struct cmark_mem {
   void *(*calloc)(size_t, size_t);
@@ -100,6 +117,34 @@ typedef struct cmark_mem {
   void (*free)(void *);
 } cmark_mem;
 
+/** Returns a pointer to the arena memory allocator.  The arena hands
+ * out memory by bumping a pointer through large chunks and ignores
+ * `free`, so a whole document (and anything rendered from it, since
+ * renderers allocate their result from the tree's allocator) can be
+ * released at once with `cmark_arena_reset`.  `cmark_node_free` only
+ * unlinks nodes allocated from the arena.
+ *
+ * The arena is per thread: memory obtained from it on one thread is
+ * released by `cmark_arena_reset` on that same thread, so a tree
+ * allocated from the arena should not be modified or rendered on any
+ * other thread.  Where the compiler offers no thread-local storage
+ * there is only one arena, which one thread at a time may use.
+ */
+CMARK_EXPORT cmark_mem *cmark_get_arena_mem_allocator(void);
+
+/** Releases everything allocated from the arena on the calling
+ * thread, invalidating all nodes, parsers and rendered strings
+ * allocated from it.  The largest chunk is kept for reuse, so parsing
+ * a stream of similarly sized documents does not call `malloc` once
+ * the arena has warmed up.
+ */
+CMARK_EXPORT void cmark_arena_reset(void);
+
+/** Like `cmark_arena_reset`, but also returns the retained chunk to
+ * the system.  Call this before a thread that used the arena exits.
+ */
+CMARK_EXPORT void cmark_arena_release(void);
+
 /**
  * ## Creating and Destroying Nodes
  */
@@ -270,6 +315,13 @@ const char *cmark_node_get_type_string(cmark_node *node);
  */
 CMARK_EXPORT const char *cmark_node_get_literal(cmark_node *node);
 
+/** Like `cmark_node_get_literal`, but stores the length of the string
+ * in 'len' (if not NULL) and neither allocates nor modifies 'node'.
+ * The returned string is not necessarily NUL-terminated.
+ */
+CMARK_EXPORT const char *cmark_node_get_literal_n(cmark_node *node,
+                                                  size_t *len);
+
 /** Sets the string contents of 'node'.  Returns 1 on success,
  * 0 on failure.
  */
@@ -329,6 +381,12 @@ CMARK_EXPORT int cmark_node_set_list_tight(cmark_node *node, int tight);
  */
 CMARK_EXPORT const char *cmark_node_get_fence_info(cmark_node *node);
 
+/** Like `cmark_node_get_fence_info`, without allocating; see
+ * `cmark_node_get_literal_n`.
+ */
+CMARK_EXPORT const char *cmark_node_get_fence_info_n(cmark_node *node,
+                                                     size_t *len);
+
 /** Sets the info string in a fenced code block, returning 1 on
  * success and 0 on failure.
  */
@@ -340,6 +398,12 @@ CMARK_EXPORT int cmark_node_set_fence_info(cmark_node *node, const char *info);
  */
 CMARK_EXPORT const char *cmark_node_get_url(cmark_node *node);
 
+/** Like `cmark_node_get_url`, without allocating; see
+ * `cmark_node_get_literal_n`.
+ */
+CMARK_EXPORT const char *cmark_node_get_url_n(cmark_node *node,
+                                              size_t *len);
+
 /** Sets the URL of a link or image 'node'. Returns 1 on success,
  * 0 on failure.
  */
@@ -351,6 +415,12 @@ CMARK_EXPORT int cmark_node_set_url(cmark_node *node, const char *url);
  */
 CMARK_EXPORT const char *cmark_node_get_title(cmark_node *node);
 
+/** Like `cmark_node_get_title`, without allocating; see
+ * `cmark_node_get_literal_n`.
+ */
+CMARK_EXPORT const char *cmark_node_get_title_n(cmark_node *node,
+                                                size_t *len);
+
 /** Sets the title of a link or image 'node'. Returns 1 on success,
  * 0 on failure.
  */
@@ -362,6 +432,12 @@ CMARK_EXPORT int cmark_node_set_title(cmark_node *node, const char *title);
  */
 CMARK_EXPORT const char *cmark_node_get_on_enter(cmark_node *node);
 
+/** Like `cmark_node_get_on_enter`, without allocating; see
+ * `cmark_node_get_literal_n`.
+ */
+CMARK_EXPORT const char *cmark_node_get_on_enter_n(cmark_node *node,
+                                                   size_t *len);
+
 /** Sets the literal text to render "on enter" for a custom 'node'.
     Any children of the node will be rendered after this text.
     Returns 1 on success 0 on failure.
@@ -375,6 +451,12 @@ CMARK_EXPORT int cmark_node_set_on_enter(cmark_node *node,
  */
 CMARK_EXPORT const char *cmark_node_get_on_exit(cmark_node *node);
 
+/** Like `cmark_node_get_on_exit`, without allocating; see
+ * `cmark_node_get_literal_n`.
+ */
+CMARK_EXPORT const char *cmark_node_get_on_exit_n(cmark_node *node,
+                                                  size_t *len);
+
 /** Sets the literal text to render "on exit" for a custom 'node'.
     Any children of the node will be rendered before this text.
     Returns 1 on success 0 on failure.
@@ -455,6 +537,10 @@ CMARK_EXPORT void cmark_consolidate_text_nodes(cmark_node *root);
  *     }
  *     document = cmark_parser_finish(parser);
  *     cmark_parser_free(parser);
+ *
+ * A parser can be reused for any number of documents by calling
+ * 'cmark_parser_reset' after 'cmark_parser_finish'; this saves most
+ * of the setup cost when parsing many small documents.
  */
 
 /** Creates a new parser object.
@@ -467,17 +553,42 @@ cmark_parser *cmark_parser_new(int options);
 CMARK_EXPORT
 cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem);
 
-/** Frees memory allocated for a parser object.
+/** Frees memory allocated for a parser object, including the
+ * document being parsed, unless it was returned by
+ * 'cmark_parser_finish'.
  */
 CMARK_EXPORT
 void cmark_parser_free(cmark_parser *parser);
 
-/** Feeds a string of length 'len' to 'parser'.
+/** Lets 'parser' parse inline content on up to 'threads' threads,
+ * the calling thread included, once the blocks of a document are
+ * parsed.  Documents too small to profit use fewer threads.  The
+ * resulting tree is the same as with a single thread, the default.
+ * The parser's memory allocator has to be thread-safe; with the arena
+ * allocator, and in builds without thread support, a single thread is
+ * used.  The setting is kept across 'cmark_parser_reset'.
+ */
+CMARK_EXPORT
+void cmark_parser_set_threads(cmark_parser *parser, int threads);
+
+/** Prepares 'parser' for a new document, to be parsed with 'options'.
+ * A document being parsed that was not returned by
+ * 'cmark_parser_finish' is freed.  Buffers and pools the parser has
+ * grown are kept for the next document.
+ */
+CMARK_EXPORT
+void cmark_parser_reset(cmark_parser *parser, int options);
+
+/** Feeds a string of length 'len' to 'parser'.  Feeding a parser
+ * whose document was finished starts a new one, as if after
+ * 'cmark_parser_reset' with the same options.
  */
 CMARK_EXPORT
 void cmark_parser_feed(cmark_parser *parser, const char *buffer, size_t len);
 
-/** Finish parsing and return a pointer to a tree of nodes.
+/** Finish parsing and return a pointer to a tree of nodes.  To parse
+ * another document with the same parser, call 'cmark_parser_reset'
+ * first.  Returns NULL if the document was finished already.
  */
 CMARK_EXPORT
 cmark_node *cmark_parser_finish(cmark_parser *parser);
@@ -490,6 +601,17 @@ cmark_node *cmark_parser_finish(cmark_parser *parser);
 CMARK_EXPORT
 cmark_node *cmark_parse_document(const char *buffer, size_t len, int options);
 
+/** Like 'cmark_parse_document', but uses up to 'threads' threads on
+ * large documents.  The input is split where the document is likely
+ * to be between blocks, and the pieces are parsed at the same time.
+ * Where a guess turns out wrong, the piece is parsed again after the
+ * one before it.  The tree is the same as 'cmark_parse_document'
+ * returns.  In builds without thread support, a single thread is used.
+ */
+CMARK_EXPORT
+cmark_node *cmark_parse_document_parallel(const char *buffer, size_t len,
+                                          int options, int threads);
+
 /** Parse a CommonMark document in file 'f', returning a pointer to
  * a tree of nodes.  The memory allocated for the node tree should be
  * released using 'cmark_node_free' when it is no longer needed.
@@ -499,6 +621,13 @@ cmark_node *cmark_parse_file(FILE *f, int options);
 
 /**
  * ## Rendering
+ *
+ * Rendering does not modify the tree, so several threads may render
+ * the same tree at once, as long as no thread modifies it meanwhile
+ * (note that the string getters such as `cmark_node_get_literal` may
+ * modify the node they are called on, unlike their `_n` variants).
+ * Rendered strings are allocated with the tree's memory allocator,
+ * which must then be thread-safe.
  */
 
 /** Render a 'node' tree as XML.  It is the caller's responsibility
@@ -514,6 +643,31 @@ char *cmark_render_xml(cmark_node *root, int options);
 CMARK_EXPORT
 char *cmark_render_html(cmark_node *root, int options);
 
+/** Called by 'cmark_render_html_to' with the next 'len' bytes of
+ * output, which are not null-terminated.  Returns 0 to go on, anything
+ * else to stop rendering.
+ */
+typedef int (*cmark_write_cb)(const char *data, size_t len, void *userdata);
+
+/** Like 'cmark_render_html', but passes the output to 'write', along
+ * with 'userdata', a piece at a time as it is rendered, instead of
+ * returning it.  Only a small buffer of fixed size is used, however
+ * large the output.  Returns 0, or the nonzero value returned by
+ * 'write' if it stopped rendering.
+ */
+CMARK_EXPORT
+int cmark_render_html_to(cmark_node *root, int options, cmark_write_cb write,
+                         void *userdata);
+
+/** Like 'cmark_render_html', but renders the children of a large
+ * document on up to 'nthreads' threads.  The result is the same as
+ * that of 'cmark_render_html'.  The tree must not be modified while
+ * it is rendered.  Trees allocated from the arena, and all trees in
+ * builds without thread support, are rendered on the calling thread.
+ */
+CMARK_EXPORT
+char *cmark_render_html_parallel(cmark_node *root, int options, int nthreads);
+
 /** Render a 'node' tree as a groff man page, without the header.
  * It is the caller's responsibility to free the returned buffer.
  */
@@ -587,6 +741,14 @@ char *cmark_render_latex(cmark_node *root, int options, int width);
  */
 #define CMARK_OPT_SMART (1 << 10)
 
+/** Let the text of the parsed tree point into the input instead of
+ * copying it.  The caller must keep every buffer passed to
+ * `cmark_parse_document` or `cmark_parser_feed` alive and unchanged
+ * until the tree (and the parser) have been freed.  `cmark_parse_file`
+ * ignores this option, as it reads the file in pieces.
+ */
+#define CMARK_OPT_RETAIN_SOURCE (1 << 18)
+
 /**
  * ## Version information
  */
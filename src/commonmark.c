@@ -13,6 +13,8 @@
 #include "render.h"
 
 #define OUT(s, wrap, escaping) renderer->out(renderer, s, wrap, escaping)
+#define OUT_N(s, len, wrap, escaping)                                          \
+  renderer->out_n(renderer, s, (bufsize_t)(len), wrap, escaping)
 #define LIT(s) renderer->out(renderer, s, false, LITERAL)
 #define CR() renderer->cr(renderer)
 #define BLANKLINE() renderer->blankline(renderer)
@@ -67,13 +69,12 @@ static CMARK_INLINE void outc(cmark_renderer *renderer, cmark_escaping escape,
   }
 }
 
-static int longest_backtick_sequence(const char *code) {
+static int longest_backtick_sequence(const char *code, size_t code_len) {
   int longest = 0;
   int current = 0;
   size_t i = 0;
-  size_t code_len = strlen(code);
   while (i <= code_len) {
-    if (code[i] == '`') {
+    if (i < code_len && code[i] == '`') {
       current++;
     } else {
       if (current > longest) {
@@ -86,15 +87,15 @@ static int longest_backtick_sequence(const char *code) {
   return longest;
 }
 
-static int shortest_unused_backtick_sequence(const char *code) {
+static int shortest_unused_backtick_sequence(const char *code,
+                                             size_t code_len) {
   // note: if the shortest sequence is >= 32, this returns 32
   // so as not to overflow the bit array.
   uint32_t used = 1;
   int current = 0;
   size_t i = 0;
-  size_t code_len = strlen(code);
   while (i <= code_len) {
-    if (code[i] == '`') {
+    if (i < code_len && code[i] == '`') {
       current++;
     } else {
       if (current > 0 && current < 32) {
@@ -139,16 +140,13 @@ static bool is_autolink(cmark_node *node) {
   if (link_text == NULL) {
     return false;
   }
-  cmark_consolidate_text_nodes(link_text);
   realurl = (char *)url->data;
   realurllen = url->len;
-  if (strncmp(realurl, "mailto:", 7) == 0) {
+  if (realurllen >= 7 && strncmp(realurl, "mailto:", 7) == 0) {
     realurl += 7;
     realurllen -= 7;
   }
-  return (realurllen == link_text->as.literal.len &&
-          strncmp(realurl, (char *)link_text->as.literal.data,
-                  link_text->as.literal.len) == 0);
+  return cmark_render_text_equals(link_text, realurl, realurllen);
 }
 
 // if node is a block node, returns node.
@@ -175,9 +173,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   bool extra_spaces;
   int i;
   bool entering = (ev_type == CMARK_EVENT_ENTER);
-  const char *info, *code, *title;
+  const char *info, *code, *url, *title, *str;
   char fencechar[2] = {'\0', '\0'};
-  size_t info_len, code_len;
+  size_t info_len, code_len, url_len, title_len, len;
   char listmarker[LISTMARKER_SIZE];
   char *emph_delim;
   bool first_in_list_item;
@@ -282,11 +280,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     if (!first_in_list_item) {
       BLANKLINE();
     }
-    info = cmark_node_get_fence_info(node);
-    info_len = strlen(info);
-    fencechar[0] = strchr(info, '`') == NULL ? '`' : '~';
-    code = cmark_node_get_literal(node);
-    code_len = strlen(code);
+    info = cmark_node_get_fence_info_n(node, &info_len);
+    fencechar[0] = memchr(info, '`', info_len) == NULL ? '`' : '~';
+    code = cmark_node_get_literal_n(node, &code_len);
     // use indented form if no info, and code doesn't
     // begin or end with a blank line, and code isn't
     // first thing in a list item
@@ -296,10 +292,10 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
         !first_in_list_item) {
       LIT("    ");
       cmark_strbuf_puts(renderer->prefix, "    ");
-      OUT(cmark_node_get_literal(node), false, LITERAL);
+      OUT_N(code, code_len, false, LITERAL);
       cmark_strbuf_truncate(renderer->prefix, renderer->prefix->size - 4);
     } else {
-      numticks = longest_backtick_sequence(code) + 1;
+      numticks = longest_backtick_sequence(code, code_len) + 1;
       if (numticks < 3) {
         numticks = 3;
       }
@@ -307,9 +303,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
         LIT(fencechar);
       }
       LIT(" ");
-      OUT(info, false, LITERAL);
+      OUT_N(info, info_len, false, LITERAL);
       CR();
-      OUT(cmark_node_get_literal(node), false, LITERAL);
+      OUT_N(code, code_len, false, LITERAL);
       CR();
       for (i = 0; i < numticks; i++) {
         LIT(fencechar);
@@ -320,14 +316,16 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_HTML_BLOCK:
     BLANKLINE();
-    OUT(cmark_node_get_literal(node), false, LITERAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     BLANKLINE();
     break;
 
   case CMARK_NODE_CUSTOM_BLOCK:
     BLANKLINE();
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     BLANKLINE();
     break;
 
@@ -344,7 +342,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_TEXT:
-    OUT(cmark_node_get_literal(node), allow_wrap, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, allow_wrap, NORMAL);
     break;
 
   case CMARK_NODE_LINEBREAK:
@@ -368,9 +367,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_CODE:
-    code = cmark_node_get_literal(node);
-    code_len = strlen(code);
-    numticks = shortest_unused_backtick_sequence(code);
+    code = cmark_node_get_literal_n(node, &code_len);
+    numticks = shortest_unused_backtick_sequence(code, code_len);
     extra_spaces = code_len == 0 ||
 	    code[0] == '`' || code[code_len - 1] == '`' ||
 	    code[0] == ' ' || code[code_len - 1] == ' ';
@@ -380,7 +378,7 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     if (extra_spaces) {
       LIT(" ");
     }
-    OUT(cmark_node_get_literal(node), allow_wrap, LITERAL);
+    OUT_N(code, code_len, allow_wrap, LITERAL);
     if (extra_spaces) {
       LIT(" ");
     }
@@ -390,12 +388,14 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_HTML_INLINE:
-    OUT(cmark_node_get_literal(node), false, LITERAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     break;
 
   case CMARK_NODE_CUSTOM_INLINE:
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     break;
 
   case CMARK_NODE_STRONG:
@@ -423,13 +423,14 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_LINK:
+    url = cmark_node_get_url_n(node, &url_len);
     if (is_autolink(node)) {
       if (entering) {
         LIT("<");
-        if (strncmp(cmark_node_get_url(node), "mailto:", 7) == 0) {
-          LIT((const char *)cmark_node_get_url(node) + 7);
+        if (url_len >= 7 && strncmp(url, "mailto:", 7) == 0) {
+          OUT_N(url + 7, url_len - 7, false, LITERAL);
         } else {
-          LIT((const char *)cmark_node_get_url(node));
+          OUT_N(url, url_len, false, LITERAL);
         }
         LIT(">");
         // return signal to skip contents of node...
@@ -440,11 +441,11 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
         LIT("[");
       } else {
         LIT("](");
-        OUT(cmark_node_get_url(node), false, URL);
-        title = cmark_node_get_title(node);
-        if (strlen(title) > 0) {
+        OUT_N(url, url_len, false, URL);
+        title = cmark_node_get_title_n(node, &title_len);
+        if (title_len > 0) {
           LIT(" \"");
-          OUT(title, false, TITLE);
+          OUT_N(title, title_len, false, TITLE);
           LIT("\"");
         }
         LIT(")");
@@ -457,11 +458,12 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
       LIT("![");
     } else {
       LIT("](");
-      OUT(cmark_node_get_url(node), false, URL);
-      title = cmark_node_get_title(node);
-      if (strlen(title) > 0) {
+      url = cmark_node_get_url_n(node, &url_len);
+      OUT_N(url, url_len, false, URL);
+      title = cmark_node_get_title_n(node, &title_len);
+      if (title_len > 0) {
         OUT(" \"", allow_wrap, LITERAL);
-        OUT(title, false, TITLE);
+        OUT_N(title, title_len, false, TITLE);
         LIT("\"");
       }
       LIT(")");
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "simd.h"
 
 /*
  * The following characters will not be escaped:
@@ -21,7 +22,7 @@
  * component/separator) and hence needs no escaping.
  *
  * There are two exceptions: the chacters & (amp)
- * and ' (single quote) do not appear in the table.
+ * and ' (single quote) are not in the safe set.
  * They are meant to appear in the URL as components,
  * yet they require special HTML-entity escaping
  * to generate valid HTML markup.
@@ -29,19 +30,18 @@
  * All other characters will be escaped to %XX.
  *
  */
-static const char HREF_SAFE[] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
-    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-};
+// The bytes that are not safe: the two rows of control characters
+// (0x03), the characters below, DEL, and everything outside ASCII.
+#define HREF_UNSAFE(n)                                                         \
+  0x03 | CMARK_BYTESET_NIB(' ', n) | CMARK_BYTESET_NIB('"', n) |               \
+      CMARK_BYTESET_NIB('&', n) | CMARK_BYTESET_NIB('\'', n) |                 \
+      CMARK_BYTESET_NIB('<', n) | CMARK_BYTESET_NIB('>', n) |                  \
+      CMARK_BYTESET_NIB('[', n) | CMARK_BYTESET_NIB('\\', n) |                 \
+      CMARK_BYTESET_NIB(']', n) | CMARK_BYTESET_NIB('^', n) |                  \
+      CMARK_BYTESET_NIB('`', n) | CMARK_BYTESET_NIB('{', n) |                  \
+      CMARK_BYTESET_NIB('|', n) | CMARK_BYTESET_NIB('}', n) |                  \
+      CMARK_BYTESET_NIB('~', n) | CMARK_BYTESET_NIB(0x7f, n)
+static const cmark_byteset HREF_UNSAFE_SET = CMARK_BYTESET(HREF_UNSAFE, true);
 
 int houdini_escape_href(cmark_strbuf *ob, const uint8_t *src, bufsize_t size) {
   static const uint8_t hex_chars[] = "0123456789ABCDEF";
@@ -50,10 +50,12 @@ int houdini_escape_href(cmark_strbuf *ob, const uint8_t *src, bufsize_t size) {
 
   hex_str[0] = '%';
 
+  // The output is at least as long as the input.
+  cmark_strbuf_grow(ob, ob->size + size);
+
   while (i < size) {
     org = i;
-    while (i < size && HREF_SAFE[src[i]] != 0)
-      i++;
+    i += cmark_byteset_find(&HREF_UNSAFE_SET, src + i, size - i);
 
     if (likely(i > org))
       cmark_strbuf_put(ob, src + org, i - org);
@@ -66,14 +68,14 @@ int houdini_escape_href(cmark_strbuf *ob, const uint8_t *src, bufsize_t size) {
     /* amp appears all the time in URLs, but needs
      * HTML-entity escaping to be inside an href */
     case '&':
-      cmark_strbuf_puts(ob, "&amp;");
+      cmark_strbuf_put(ob, (const unsigned char *)"&amp;", 5);
       break;
 
     /* the single quote is a valid URL character
      * according to the standard; it needs HTML
      * entity escaping too */
     case '\'':
-      cmark_strbuf_puts(ob, "&#x27;");
+      cmark_strbuf_put(ob, (const unsigned char *)"&#x27;", 6);
       break;
 
 /* the space can be escaped to %20 or a plus
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "simd.h"
 
 /**
  * According to the OWASP rules:
@@ -31,15 +32,32 @@ static const char HTML_ESCAPE_TABLE[] = {
 
 static const char *HTML_ESCAPES[] = {"",      "&quot;", "&amp;", "&#39;",
                                      "&#47;", "&lt;",   "&gt;"};
+static const bufsize_t HTML_ESCAPE_LENGTHS[] = {0, 6, 5, 5, 5, 4, 4};
+
+// Bytes that need escaping, in secure mode and otherwise.
+#define SECURE_ESCAPES(n)                                                      \
+  CMARK_BYTESET_NIB('"', n) | CMARK_BYTESET_NIB('&', n) |                      \
+      CMARK_BYTESET_NIB('\'', n) | CMARK_BYTESET_NIB('/', n) |                 \
+      CMARK_BYTESET_NIB('<', n) | CMARK_BYTESET_NIB('>', n)
+#define ESCAPES(n)                                                             \
+  CMARK_BYTESET_NIB('"', n) | CMARK_BYTESET_NIB('&', n) |                      \
+      CMARK_BYTESET_NIB('<', n) | CMARK_BYTESET_NIB('>', n)
+static const cmark_byteset HTML_SECURE_ESCAPE_SET =
+    CMARK_BYTESET(SECURE_ESCAPES, false);
+static const cmark_byteset HTML_ESCAPE_SET = CMARK_BYTESET(ESCAPES, false);
 
 int houdini_escape_html0(cmark_strbuf *ob, const uint8_t *src, bufsize_t size,
                          int secure) {
-  bufsize_t i = 0, org, esc = 0;
+  const cmark_byteset *set =
+      secure ? &HTML_SECURE_ESCAPE_SET : &HTML_ESCAPE_SET;
+  bufsize_t i = 0, org, esc;
+
+  // The output is at least as long as the input.
+  cmark_strbuf_grow(ob, ob->size + size);
 
   while (i < size) {
     org = i;
-    while (i < size && (esc = HTML_ESCAPE_TABLE[src[i]]) == 0)
-      i++;
+    i += cmark_byteset_find(set, src + i, size - i);
 
     if (i > org)
       cmark_strbuf_put(ob, src + org, i - org);
@@ -48,12 +66,9 @@ int houdini_escape_html0(cmark_strbuf *ob, const uint8_t *src, bufsize_t size,
     if (unlikely(i >= size))
       break;
 
-    /* The forward slash is only escaped in secure mode */
-    if ((src[i] == '/' || src[i] == '\'') && !secure) {
-      cmark_strbuf_putc(ob, src[i]);
-    } else {
-      cmark_strbuf_puts(ob, HTML_ESCAPES[esc]);
-    }
+    esc = HTML_ESCAPE_TABLE[src[i]];
+    cmark_strbuf_put(ob, (const unsigned char *)HTML_ESCAPES[esc],
+                     HTML_ESCAPE_LENGTHS[esc]);
 
     i++;
   }
@@ -7,32 +7,42 @@
 #include "utf8.h"
 #include "entities.inc"
 
-/* Binary tree lookup code for entities added by JGM */
-
-static const unsigned char *S_lookup(int i, int low, int hi,
-                                     const unsigned char *s, int len) {
-  int j;
-  int cmp =
-      strncmp((const char *)s, (const char *)cmark_entities[i].entity, len);
-  if (cmp == 0 && cmark_entities[i].entity[len] == 0) {
-    return (const unsigned char *)cmark_entities[i].bytes;
-  } else if (cmp <= 0 && i > low) {
-    j = i - ((i - low) / 2);
-    if (j == i)
-      j -= 1;
-    return S_lookup(j, low, i - 1, s, len);
-  } else if (cmp > 0 && i < hi) {
-    j = i + ((hi - i) / 2);
-    if (j == i)
-      j += 1;
-    return S_lookup(j, i + 1, hi, s, len);
-  } else {
-    return NULL;
-  }
+/* Perfect hash lookup of entities; the tables and the seeds are
+ * generated by tools/make_entities_inc.py, which has to agree with
+ * the two functions below. */
+
+static CMARK_INLINE uint32_t entity_hash(const unsigned char *s, int len) {
+  uint32_t h = 2166136261u;
+  int i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ s[i]) * 16777619u;
+  return h;
+}
+
+static CMARK_INLINE uint32_t entity_slot(uint32_t h, uint32_t seed) {
+  h ^= seed;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h & (CMARK_ENTITY_HASH_SLOTS - 1);
 }
 
 static const unsigned char *S_lookup_entity(const unsigned char *s, int len) {
-  return S_lookup(CMARK_NUM_ENTITIES / 2, 0, CMARK_NUM_ENTITIES - 1, s, len);
+  uint32_t h = entity_hash(s, len);
+  uint32_t seed = cmark_entity_seeds[h & (CMARK_ENTITY_HASH_BUCKETS - 1)];
+  int slot = cmark_entity_slots[entity_slot(h, seed)];
+  const struct cmark_entity_node *e;
+
+  if (slot == 0)
+    return NULL;
+
+  e = &cmark_entities[slot - 1];
+  if (e->length != len || memcmp(s, e->entity, len) != 0)
+    return NULL;
+  return e->bytes;
 }
 
 bufsize_t houdini_unescape_ent(cmark_strbuf *ob, const uint8_t *src,
@@ -9,9 +9,14 @@
 #include "buffer.h"
 #include "houdini.h"
 #include "scanners.h"
+#include "thread.h"
+#include "arena.h"
 
 #define BUFFER_SIZE 100
 
+// How much output cmark_render_html_to collects before passing it on.
+#define HTML_FLUSH_SIZE 16384
+
 // Functions to convert cmark_nodes to HTML strings.
 
 static void escape_html(cmark_strbuf *dest, const unsigned char *source,
@@ -19,6 +24,15 @@ static void escape_html(cmark_strbuf *dest, const unsigned char *source,
   houdini_escape_html0(dest, source, length, 0);
 }
 
+static void escape_href(cmark_strbuf *dest, const unsigned char *source,
+                        bufsize_t length) {
+  houdini_escape_href(dest, source, length);
+}
+
+// Appends source to dest, escaped or not.
+typedef void (*html_put_fn)(cmark_strbuf *dest, const unsigned char *source,
+                            bufsize_t length);
+
 static CMARK_INLINE void cr(cmark_strbuf *html) {
   if (html->size && html->ptr[html->size - 1] != '\n')
     cmark_strbuf_putc(html, '\n');
@@ -27,8 +41,46 @@ static CMARK_INLINE void cr(cmark_strbuf *html) {
 struct render_state {
   cmark_strbuf *html;
   cmark_node *plain;
+  // Set when streaming; see cmark_render_html_to.
+  cmark_write_cb write;
+  void *userdata;
+  int status;
 };
 
+// Hands the output collected so far to the write callback, except for
+// its last byte, which cr needs to see.  After the callback has failed
+// the output is dropped.
+static void S_flush(struct render_state *state) {
+  cmark_strbuf *html = state->html;
+  bufsize_t len = html->size - 1;
+
+  if (len <= 0)
+    return;
+  if (state->status == 0)
+    state->status =
+        state->write((const char *)html->ptr, (size_t)len, state->userdata);
+  html->ptr[0] = html->ptr[len];
+  cmark_strbuf_truncate(html, 1);
+}
+
+// Appends text from the tree with put.  When streaming, long text is
+// written in slices, so that the buffer stays about HTML_FLUSH_SIZE
+// bytes; escaping works byte by byte, so slices can end anywhere.
+static void S_put(struct render_state *state, html_put_fn put,
+                  const unsigned char *data, bufsize_t len) {
+  bufsize_t n;
+
+  for (;;) {
+    n = state->write && len > HTML_FLUSH_SIZE ? HTML_FLUSH_SIZE : len;
+    put(state->html, data, n);
+    data += n;
+    len -= n;
+    if (len == 0)
+      break;
+    S_flush(state);
+  }
+}
+
 static void S_render_sourcepos(cmark_node *node, cmark_strbuf *html,
                                int options) {
   char buffer[BUFFER_SIZE];
@@ -61,7 +113,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     case CMARK_NODE_TEXT:
     case CMARK_NODE_CODE:
     case CMARK_NODE_HTML_INLINE:
-      escape_html(html, node->as.literal.data, node->as.literal.len);
+      S_put(state, escape_html, node->as.literal.data, node->as.literal.len);
       break;
 
     case CMARK_NODE_LINEBREAK:
@@ -160,11 +212,12 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
       cmark_strbuf_puts(html, "<pre");
       S_render_sourcepos(node, html, options);
       cmark_strbuf_puts(html, "><code class=\"language-");
-      escape_html(html, node->as.code.info.data, first_tag);
+      S_put(state, escape_html, node->as.code.info.data, first_tag);
       cmark_strbuf_puts(html, "\">");
     }
 
-    escape_html(html, node->as.code.literal.data, node->as.code.literal.len);
+    S_put(state, escape_html, node->as.code.literal.data,
+          node->as.code.literal.len);
     cmark_strbuf_puts(html, "</code></pre>\n");
     break;
 
@@ -173,7 +226,8 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     if (!(options & CMARK_OPT_UNSAFE)) {
       cmark_strbuf_puts(html, "<!-- raw HTML omitted -->");
     } else {
-      cmark_strbuf_put(html, node->as.literal.data, node->as.literal.len);
+      S_put(state, cmark_strbuf_put, node->as.literal.data,
+            node->as.literal.len);
     }
     cr(html);
     break;
@@ -181,11 +235,11 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
   case CMARK_NODE_CUSTOM_BLOCK:
     cr(html);
     if (entering) {
-      cmark_strbuf_put(html, node->as.custom.on_enter.data,
-                       node->as.custom.on_enter.len);
+      S_put(state, cmark_strbuf_put, node->as.custom.on_enter.data,
+            node->as.custom.on_enter.len);
     } else {
-      cmark_strbuf_put(html, node->as.custom.on_exit.data,
-                       node->as.custom.on_exit.len);
+      S_put(state, cmark_strbuf_put, node->as.custom.on_exit.data,
+            node->as.custom.on_exit.len);
     }
     cr(html);
     break;
@@ -218,7 +272,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     break;
 
   case CMARK_NODE_TEXT:
-    escape_html(html, node->as.literal.data, node->as.literal.len);
+    S_put(state, escape_html, node->as.literal.data, node->as.literal.len);
     break;
 
   case CMARK_NODE_LINEBREAK:
@@ -237,7 +291,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
 
   case CMARK_NODE_CODE:
     cmark_strbuf_puts(html, "<code>");
-    escape_html(html, node->as.literal.data, node->as.literal.len);
+    S_put(state, escape_html, node->as.literal.data, node->as.literal.len);
     cmark_strbuf_puts(html, "</code>");
     break;
 
@@ -245,17 +299,18 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     if (!(options & CMARK_OPT_UNSAFE)) {
       cmark_strbuf_puts(html, "<!-- raw HTML omitted -->");
     } else {
-      cmark_strbuf_put(html, node->as.literal.data, node->as.literal.len);
+      S_put(state, cmark_strbuf_put, node->as.literal.data,
+            node->as.literal.len);
     }
     break;
 
   case CMARK_NODE_CUSTOM_INLINE:
     if (entering) {
-      cmark_strbuf_put(html, node->as.custom.on_enter.data,
-                       node->as.custom.on_enter.len);
+      S_put(state, cmark_strbuf_put, node->as.custom.on_enter.data,
+            node->as.custom.on_enter.len);
     } else {
-      cmark_strbuf_put(html, node->as.custom.on_exit.data,
-                       node->as.custom.on_exit.len);
+      S_put(state, cmark_strbuf_put, node->as.custom.on_exit.data,
+            node->as.custom.on_exit.len);
     }
     break;
 
@@ -280,12 +335,13 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
       cmark_strbuf_puts(html, "<a href=\"");
       if ((options & CMARK_OPT_UNSAFE) ||
             !(scan_dangerous_url(&node->as.link.url, 0))) {
-        houdini_escape_href(html, node->as.link.url.data,
-                            node->as.link.url.len);
+        S_put(state, escape_href, node->as.link.url.data,
+              node->as.link.url.len);
       }
       if (node->as.link.title.len) {
         cmark_strbuf_puts(html, "\" title=\"");
-        escape_html(html, node->as.link.title.data, node->as.link.title.len);
+        S_put(state, escape_html, node->as.link.title.data,
+              node->as.link.title.len);
       }
       cmark_strbuf_puts(html, "\">");
     } else {
@@ -298,15 +354,16 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
       cmark_strbuf_puts(html, "<img src=\"");
       if ((options & CMARK_OPT_UNSAFE) ||
             !(scan_dangerous_url(&node->as.link.url, 0))) {
-        houdini_escape_href(html, node->as.link.url.data,
-                            node->as.link.url.len);
+        S_put(state, escape_href, node->as.link.url.data,
+              node->as.link.url.len);
       }
       cmark_strbuf_puts(html, "\" alt=\"");
       state->plain = node;
     } else {
       if (node->as.link.title.len) {
         cmark_strbuf_puts(html, "\" title=\"");
-        escape_html(html, node->as.link.title.data, node->as.link.title.len);
+        S_put(state, escape_html, node->as.link.title.data,
+              node->as.link.title.len);
       }
 
       cmark_strbuf_puts(html, "\" />");
@@ -327,7 +384,7 @@ char *cmark_render_html(cmark_node *root, int options) {
   cmark_strbuf html = CMARK_BUF_INIT(cmark_node_mem(root));
   cmark_event_type ev_type;
   cmark_node *cur;
-  struct render_state state = {&html, NULL};
+  struct render_state state = {&html, NULL, NULL, NULL, 0};
   cmark_iter *iter = cmark_iter_new(root);
 
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
@@ -339,3 +396,146 @@ char *cmark_render_html(cmark_node *root, int options) {
   cmark_iter_free(iter);
   return result;
 }
+
+int cmark_render_html_to(cmark_node *root, int options, cmark_write_cb write,
+                         void *userdata) {
+  cmark_strbuf html = CMARK_BUF_INIT(cmark_node_mem(root));
+  cmark_event_type ev_type;
+  cmark_node *cur;
+  struct render_state state = {&html, NULL, write, userdata, 0};
+  cmark_iter *iter = cmark_iter_new(root);
+
+  cmark_strbuf_grow(&html, HTML_FLUSH_SIZE + BUFFER_SIZE);
+  while (state.status == 0 &&
+         (ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    S_render_node(cur, ev_type, &state, options);
+    if (html.size >= HTML_FLUSH_SIZE)
+      S_flush(&state);
+  }
+  if (state.status == 0 && html.size > 0)
+    state.status = write((const char *)html.ptr, (size_t)html.size, userdata);
+
+  cmark_strbuf_free(&html);
+  cmark_iter_free(iter);
+  return state.status;
+}
+
+#ifdef CMARK_THREADS
+
+// Lines of top-level blocks a rendering thread should at least get.
+#define HTML_THREAD_MIN 4096
+
+// A run of top-level blocks that one thread renders.
+typedef struct {
+  cmark_node *first;
+  cmark_node *last;
+  int options;
+  cmark_strbuf html;
+} html_run;
+
+static void render_run(html_run *run) {
+  struct render_state state = {&run->html, NULL, NULL, NULL, 0};
+  cmark_event_type ev_type;
+  cmark_node *node, *cur;
+  cmark_iter *iter;
+
+  for (node = run->first;; node = node->next) {
+    iter = cmark_iter_new(node);
+    while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+      cur = cmark_iter_get_node(iter);
+      S_render_node(cur, ev_type, &state, run->options);
+    }
+    cmark_iter_free(iter);
+    if (node == run->last)
+      break;
+  }
+}
+
+static CMARK_THREAD_FUNC(html_thread) {
+  render_run((html_run *)arg);
+  CMARK_THREAD_RETURN;
+}
+
+static size_t S_block_lines(cmark_node *node) {
+  return (size_t)(cmark_cold(node)->end_line - cmark_cold(node)->start_line) +
+         1;
+}
+
+#endif
+
+// Renders runs of the document's children, of about equal numbers of
+// lines, on separate threads and concatenates the results.  The
+// document itself renders as nothing, and the only state carried from
+// one top-level block to the next is whether the output ends with a
+// newline, which cr looks at.  It always does, as the HTML of every
+// block is empty or ends with a newline, so a run can start with an
+// empty buffer.
+char *cmark_render_html_parallel(cmark_node *root, int options, int nthreads) {
+#ifdef CMARK_THREADS
+  cmark_mem *mem = cmark_node_mem(root);
+  cmark_strbuf html = CMARK_BUF_INIT(mem);
+  html_run *runs;
+  cmark_thread *threads;
+  bool *started;
+  cmark_node *node;
+  size_t total = 0, share, size;
+  bufsize_t bytes = 0;
+  int nruns = nthreads, r;
+
+  // The arena is per thread, so the runs could not be rendered into
+  // the tree's.
+  if (root->type != CMARK_NODE_DOCUMENT || mem == &CMARK_ARENA_MEM_ALLOCATOR)
+    nruns = 1;
+  for (node = root->first_child; node && nruns > 1; node = node->next)
+    total += S_block_lines(node);
+  if (total / HTML_THREAD_MIN < (size_t)nruns)
+    nruns = (int)(total / HTML_THREAD_MIN);
+  if (nruns < 2)
+    return cmark_render_html(root, options);
+
+  runs = (html_run *)mem->calloc(nruns, sizeof(*runs));
+  share = total / nruns + 1;
+  node = root->first_child;
+  for (r = 0; r < nruns && node; r++) {
+    runs[r].first = node;
+    runs[r].options = options;
+    cmark_strbuf_init(mem, &runs[r].html, 0);
+    for (size = 0; node && (size < share || r == nruns - 1);
+         node = node->next) {
+      size += S_block_lines(node);
+      runs[r].last = node;
+    }
+  }
+  nruns = r;
+
+  threads = (cmark_thread *)mem->calloc(nruns, sizeof(*threads));
+  started = (bool *)mem->calloc(nruns, sizeof(*started));
+  for (r = 1; r < nruns; r++)
+    started[r] = cmark_thread_create(&threads[r], html_thread, &runs[r]);
+  render_run(&runs[0]);
+  for (r = 1; r < nruns; r++) {
+    if (started[r])
+      cmark_thread_join(threads[r]);
+    else
+      render_run(&runs[r]);
+  }
+
+  for (r = 0; r < nruns; r++)
+    bytes += runs[r].html.size;
+  cmark_strbuf_swap(&html, &runs[0].html);
+  cmark_strbuf_grow(&html, bytes);
+  for (r = 1; r < nruns; r++)
+    cmark_strbuf_put(&html, runs[r].html.ptr, runs[r].html.size);
+
+  for (r = 0; r < nruns; r++)
+    cmark_strbuf_free(&runs[r].html);
+  mem->free(started);
+  mem->free(threads);
+  mem->free(runs);
+  return (char *)cmark_strbuf_detach(&html);
+#else
+  (void)nthreads;
+  return cmark_render_html(root, options);
+#endif
+}
@@ -12,6 +12,7 @@
 #include "utf8.h"
 #include "scanners.h"
 #include "inlines.h"
+#include "simd.h"
 
 static const char *EMDASH = "\xE2\x80\x94";
 static const char *ENDASH = "\xE2\x80\x93";
@@ -25,10 +26,10 @@ static const char *RIGHTSINGLEQUOTE = "\xE2\x80\x99";
 #define make_str(subj, sc, ec, s) make_literal(subj, CMARK_NODE_TEXT, sc, ec, s)
 #define make_code(subj, sc, ec, s) make_literal(subj, CMARK_NODE_CODE, sc, ec, s)
 #define make_raw_html(subj, sc, ec, s) make_literal(subj, CMARK_NODE_HTML_INLINE, sc, ec, s)
-#define make_linebreak(mem) make_simple(mem, CMARK_NODE_LINEBREAK)
-#define make_softbreak(mem) make_simple(mem, CMARK_NODE_SOFTBREAK)
-#define make_emph(mem) make_simple(mem, CMARK_NODE_EMPH)
-#define make_strong(mem) make_simple(mem, CMARK_NODE_STRONG)
+#define make_linebreak(subj) make_simple(subj, CMARK_NODE_LINEBREAK)
+#define make_softbreak(subj) make_simple(subj, CMARK_NODE_SOFTBREAK)
+#define make_emph(subj) make_simple(subj, CMARK_NODE_EMPH)
+#define make_strong(subj) make_simple(subj, CMARK_NODE_STRONG)
 
 #define MAXBACKTICKS 1000
 
@@ -52,6 +53,27 @@ typedef struct bracket {
   bool bracket_after;
 } bracket;
 
+// Delimiters and brackets are carved out of blocks of POOL_RECORDS
+// records and go onto a free list when they are removed, so that once
+// the pool has grown, inline parsing allocates nothing for them.
+#define POOL_RECORDS 64
+
+typedef struct pool_block {
+  struct pool_block *next;
+  // Keeps the records that follow aligned.
+  union {
+    void *p;
+    bufsize_t n;
+  } align;
+} pool_block;
+
+struct cmark_inline_pool {
+  cmark_mem *mem;
+  pool_block *blocks;
+  delimiter *free_delims;
+  bracket *free_brackets;
+};
+
 typedef struct {
   cmark_mem *mem;
   cmark_chunk input;
@@ -60,10 +82,17 @@ typedef struct {
   int block_offset;
   int column_offset;
   cmark_reference_map *refmap;
+  cmark_strbuf *label_buf;
+  cmark_inline_pool *pool;
+  cmark_node_cache *nodes;
   delimiter *last_delim;
   bracket *last_bracket;
   bufsize_t backticks[MAXBACKTICKS + 1];
   bool scanned_for_backticks;
+  // The re2c scanners write a NUL after the end of their input while
+  // they run, so a read-only input is copied for them; see scan_input.
+  bool read_only;
+  cmark_chunk scan_copy;
 } subject;
 
 static CMARK_INLINE bool S_is_line_end_char(char c) {
@@ -76,28 +105,30 @@ static delimiter *S_insert_emph(subject *subj, delimiter *opener,
 static int parse_inline(subject *subj, cmark_node *parent, int options);
 
 static void subject_from_buf(cmark_mem *mem, int line_number, int block_offset, subject *e,
-                             cmark_chunk *chunk, cmark_reference_map *refmap);
+                             cmark_chunk *chunk, cmark_reference_map *refmap,
+                             cmark_strbuf *label_buf, cmark_inline_pool *pool,
+                             cmark_node_cache *nodes);
 static bufsize_t subject_find_special_char(subject *subj, int options);
 
 // Create an inline with a literal string value.
 static CMARK_INLINE cmark_node *make_literal(subject *subj, cmark_node_type t,
                                              int start_column, int end_column,
                                              cmark_chunk s) {
-  cmark_node *e = (cmark_node *)subj->mem->calloc(1, sizeof(*e));
-  cmark_strbuf_init(subj->mem, &e->content, 0);
+  cmark_node *e = cmark_node_alloc(subj->mem, subj->nodes);
+  cmark_node_cold *cold = cmark_cold(e);
   e->type = (uint16_t)t;
   e->as.literal = s;
-  e->start_line = e->end_line = subj->line;
+  cold->start_line = cold->end_line = subj->line;
   // columns are 1 based.
-  e->start_column = start_column + 1 + subj->column_offset + subj->block_offset;
-  e->end_column = end_column + 1 + subj->column_offset + subj->block_offset;
+  cold->start_column =
+      start_column + 1 + subj->column_offset + subj->block_offset;
+  cold->end_column = end_column + 1 + subj->column_offset + subj->block_offset;
   return e;
 }
 
 // Create an inline with no value.
-static CMARK_INLINE cmark_node *make_simple(cmark_mem *mem, cmark_node_type t) {
-  cmark_node *e = (cmark_node *)mem->calloc(1, sizeof(*e));
-  cmark_strbuf_init(mem, &e->content, 0);
+static CMARK_INLINE cmark_node *make_simple(subject *subj, cmark_node_type t) {
+  cmark_node *e = cmark_node_alloc(subj->mem, subj->nodes);
   e->type = t;
   return e;
 }
@@ -152,18 +183,20 @@ static cmark_chunk cmark_clean_autolink(cmark_mem *mem, cmark_chunk *url,
 static CMARK_INLINE cmark_node *make_autolink(subject *subj,
                                               int start_column, int end_column,
                                               cmark_chunk url, int is_email) {
-  cmark_node *link = make_simple(subj->mem, CMARK_NODE_LINK);
+  cmark_node *link = make_simple(subj, CMARK_NODE_LINK);
   link->as.link.url = cmark_clean_autolink(subj->mem, &url, is_email);
   link->as.link.title = cmark_chunk_literal("");
-  link->start_line = link->end_line = subj->line;
-  link->start_column = start_column + 1;
-  link->end_column = end_column + 1;
+  cmark_cold(link)->start_line = cmark_cold(link)->end_line = subj->line;
+  cmark_cold(link)->start_column = start_column + 1;
+  cmark_cold(link)->end_column = end_column + 1;
   cmark_node_append_child(link, make_str_with_entities(subj, start_column + 1, end_column - 1, &url));
   return link;
 }
 
 static void subject_from_buf(cmark_mem *mem, int line_number, int block_offset, subject *e,
-                             cmark_chunk *chunk, cmark_reference_map *refmap) {
+                             cmark_chunk *chunk, cmark_reference_map *refmap,
+                             cmark_strbuf *label_buf, cmark_inline_pool *pool,
+                             cmark_node_cache *nodes) {
   int i;
   e->mem = mem;
   e->input = *chunk;
@@ -172,12 +205,27 @@ static void subject_from_buf(cmark_mem *mem, int line_number, int block_offset,
   e->block_offset = block_offset;
   e->column_offset = 0;
   e->refmap = refmap;
+  e->label_buf = label_buf;
+  e->pool = pool;
+  e->nodes = nodes;
   e->last_delim = NULL;
   e->last_bracket = NULL;
   for (i = 0; i <= MAXBACKTICKS; i++) {
     e->backticks[i] = 0;
   }
   e->scanned_for_backticks = false;
+  e->read_only = false;
+  e->scan_copy.data = NULL;
+  e->scan_copy.len = 0;
+  e->scan_copy.alloc = 0;
+}
+
+static cmark_chunk *scan_input(subject *subj) {
+  if (!subj->read_only)
+    return &subj->input;
+  if (!subj->scan_copy.alloc)
+    subj->scan_copy = chunk_clone(subj->mem, &subj->input);
+  return &subj->scan_copy;
 }
 
 static CMARK_INLINE int isbacktick(int c) { return (c == '`'); }
@@ -272,8 +320,8 @@ static void adjust_subj_node_newlines(subject *subj, cmark_node *node, int match
   int newlines = count_newlines(subj, subj->pos - matchlen - extra, matchlen, &since_newline);
   if (newlines) {
     subj->line += newlines;
-    node->end_line += newlines;
-    node->end_column = since_newline;
+    cmark_cold(node)->end_line += newlines;
+    cmark_cold(node)->end_column = since_newline;
     subj->column_offset = -subj->pos + since_newline + extra;
   }
 }
@@ -464,6 +512,58 @@ static void print_delimiters(subject *subj)
 }
 */
 
+cmark_inline_pool *cmark_inline_pool_new(cmark_mem *mem) {
+  cmark_inline_pool *pool =
+      (cmark_inline_pool *)mem->calloc(1, sizeof(cmark_inline_pool));
+  pool->mem = mem;
+  return pool;
+}
+
+void cmark_inline_pool_free(cmark_inline_pool *pool) {
+  pool_block *block = pool->blocks;
+  while (block) {
+    pool_block *next = block->next;
+    pool->mem->free(block);
+    block = next;
+  }
+  pool->mem->free(pool);
+}
+
+// Returns an array of POOL_RECORDS records of the given size.
+static void *pool_grow(cmark_inline_pool *pool, size_t size) {
+  pool_block *block = (pool_block *)pool->mem->calloc(
+      1, sizeof(pool_block) + POOL_RECORDS * size);
+  block->next = pool->blocks;
+  pool->blocks = block;
+  return block + 1;
+}
+
+static delimiter *alloc_delimiter(cmark_inline_pool *pool) {
+  delimiter *delim = pool->free_delims;
+  int i;
+
+  if (delim == NULL) {
+    delim = (delimiter *)pool_grow(pool, sizeof(delimiter));
+    for (i = 0; i < POOL_RECORDS - 1; i++)
+      delim[i].next = &delim[i + 1];
+  }
+  pool->free_delims = delim->next;
+  return delim;
+}
+
+static bracket *alloc_bracket(cmark_inline_pool *pool) {
+  bracket *b = pool->free_brackets;
+  int i;
+
+  if (b == NULL) {
+    b = (bracket *)pool_grow(pool, sizeof(bracket));
+    for (i = 0; i < POOL_RECORDS - 1; i++)
+      b[i].previous = &b[i + 1];
+  }
+  pool->free_brackets = b->previous;
+  return b;
+}
+
 static void remove_delimiter(subject *subj, delimiter *delim) {
   if (delim == NULL)
     return;
@@ -477,7 +577,8 @@ static void remove_delimiter(subject *subj, delimiter *delim) {
   if (delim->previous != NULL) {
     delim->previous->next = delim->next;
   }
-  subj->mem->free(delim);
+  delim->next = subj->pool->free_delims;
+  subj->pool->free_delims = delim;
 }
 
 static void pop_bracket(subject *subj) {
@@ -486,12 +587,13 @@ static void pop_bracket(subject *subj) {
     return;
   b = subj->last_bracket;
   subj->last_bracket = subj->last_bracket->previous;
-  subj->mem->free(b);
+  b->previous = subj->pool->free_brackets;
+  subj->pool->free_brackets = b;
 }
 
 static void push_delimiter(subject *subj, unsigned char c, bool can_open,
                            bool can_close, cmark_node *inl_text) {
-  delimiter *delim = (delimiter *)subj->mem->calloc(1, sizeof(delimiter));
+  delimiter *delim = alloc_delimiter(subj->pool);
   delim->delim_char = c;
   delim->can_open = can_open;
   delim->can_close = can_close;
@@ -506,7 +608,7 @@ static void push_delimiter(subject *subj, unsigned char c, bool can_open,
 }
 
 static void push_bracket(subject *subj, bool image, cmark_node *inl_text) {
-  bracket *b = (bracket *)subj->mem->calloc(1, sizeof(bracket));
+  bracket *b = alloc_bracket(subj->pool);
   if (subj->last_bracket != NULL) {
     subj->last_bracket->bracket_after = true;
   }
@@ -729,7 +831,7 @@ static delimiter *S_insert_emph(subject *subj, delimiter *opener,
 
   // create new emph or strong, and splice it in to our inlines
   // between the opener and closer
-  emph = use_delims == 1 ? make_emph(subj->mem) : make_strong(subj->mem);
+  emph = use_delims == 1 ? make_emph(subj) : make_strong(subj);
 
   tmp = opener_inl->next;
   while (tmp && tmp != closer_inl) {
@@ -739,10 +841,10 @@ static delimiter *S_insert_emph(subject *subj, delimiter *opener,
   }
   cmark_node_insert_after(opener_inl, emph);
 
-  emph->start_line = opener_inl->start_line;
-  emph->end_line = closer_inl->end_line;
-  emph->start_column = opener_inl->start_column;
-  emph->end_column = closer_inl->end_column;
+  cmark_cold(emph)->start_line = cmark_cold(opener_inl)->start_line;
+  cmark_cold(emph)->end_line = cmark_cold(closer_inl)->end_line;
+  cmark_cold(emph)->start_column = cmark_cold(opener_inl)->start_column;
+  cmark_cold(emph)->end_column = cmark_cold(closer_inl)->end_column;
 
   // if opener has 0 characters, remove it and its associated inline
   if (opener_num_chars == 0) {
@@ -772,7 +874,7 @@ static cmark_node *handle_backslash(subject *subj) {
     advance(subj);
     return make_str(subj, subj->pos - 2, subj->pos - 1, cmark_chunk_dup(&subj->input, subj->pos - 1, 1));
   } else if (!is_eof(subj) && skip_line_end(subj)) {
-    return make_linebreak(subj->mem);
+    return make_linebreak(subj);
   } else {
     return make_str(subj, subj->pos - 1, subj->pos - 1, cmark_chunk_literal("\\"));
   }
@@ -847,7 +949,7 @@ static cmark_node *handle_pointy_brace(subject *subj, int options) {
   advance(subj); // advance past first <
 
   // first try to match a URL autolink
-  matchlen = scan_autolink_uri(&subj->input, subj->pos);
+  matchlen = scan_autolink_uri(scan_input(subj), subj->pos);
   if (matchlen > 0) {
     contents = cmark_chunk_dup(&subj->input, subj->pos, matchlen - 1);
     subj->pos += matchlen;
@@ -856,7 +958,7 @@ static cmark_node *handle_pointy_brace(subject *subj, int options) {
   }
 
   // next try to match an email autolink
-  matchlen = scan_autolink_email(&subj->input, subj->pos);
+  matchlen = scan_autolink_email(scan_input(subj), subj->pos);
   if (matchlen > 0) {
     contents = cmark_chunk_dup(&subj->input, subj->pos, matchlen - 1);
     subj->pos += matchlen;
@@ -865,7 +967,7 @@ static cmark_node *handle_pointy_brace(subject *subj, int options) {
   }
 
   // finally, try to match an html tag
-  matchlen = scan_html_tag(&subj->input, subj->pos);
+  matchlen = scan_html_tag(scan_input(subj), subj->pos);
   if (matchlen > 0) {
     contents = cmark_chunk_dup(&subj->input, subj->pos - 1, matchlen + 1);
     subj->pos += matchlen;
@@ -1034,20 +1136,20 @@ static cmark_node *handle_close_bracket(subject *subj) {
 
   // First, look for an inline link.
   if (peek_char(subj) == '(' &&
-      ((sps = scan_spacechars(&subj->input, subj->pos + 1)) > -1) &&
+      ((sps = scan_spacechars(scan_input(subj), subj->pos + 1)) > -1) &&
       ((n = manual_scan_link_url(&subj->input, subj->pos + 1 + sps,
                                  &url_chunk)) > -1)) {
 
     // try to parse an explicit link:
     endurl = subj->pos + 1 + sps + n;
-    starttitle = endurl + scan_spacechars(&subj->input, endurl);
+    starttitle = endurl + scan_spacechars(scan_input(subj), endurl);
 
     // ensure there are spaces btw url and title
     endtitle = (starttitle == endurl)
                    ? starttitle
-                   : starttitle + scan_link_title(&subj->input, starttitle);
+                   : starttitle + scan_link_title(scan_input(subj), starttitle);
 
-    endall = endtitle + scan_spacechars(&subj->input, endtitle);
+    endall = endtitle + scan_spacechars(scan_input(subj), endtitle);
 
     if (peek_at(subj, endall) == ')') {
       subj->pos = endall + 1;
@@ -1084,7 +1186,7 @@ static cmark_node *handle_close_bracket(subject *subj) {
   }
 
   if (found_label) {
-    ref = cmark_reference_lookup(subj->refmap, &raw_label);
+    ref = cmark_reference_lookup(subj->refmap, &raw_label, subj->label_buf);
     cmark_chunk_free(subj->mem, &raw_label);
   }
 
@@ -1103,12 +1205,13 @@ noMatch:
   return make_str(subj, subj->pos - 1, subj->pos - 1, cmark_chunk_literal("]"));
 
 match:
-  inl = make_simple(subj->mem, is_image ? CMARK_NODE_IMAGE : CMARK_NODE_LINK);
+  inl = make_simple(subj, is_image ? CMARK_NODE_IMAGE : CMARK_NODE_LINK);
   inl->as.link.url = url;
   inl->as.link.title = title;
-  inl->start_line = inl->end_line = subj->line;
-  inl->start_column = opener->inl_text->start_column;
-  inl->end_column = subj->pos + subj->column_offset + subj->block_offset;
+  cmark_cold(inl)->start_line = cmark_cold(inl)->end_line = subj->line;
+  cmark_cold(inl)->start_column = cmark_cold(opener->inl_text)->start_column;
+  cmark_cold(inl)->end_column =
+      subj->pos + subj->column_offset + subj->block_offset;
   cmark_node_insert_before(opener->inl_text, inl);
   // Add link text:
   tmp = opener->inl_text->next;
@@ -1161,53 +1264,40 @@ static cmark_node *handle_newline(subject *subj) {
   skip_spaces(subj);
   if (nlpos > 1 && peek_at(subj, nlpos - 1) == ' ' &&
       peek_at(subj, nlpos - 2) == ' ') {
-    return make_linebreak(subj->mem);
+    return make_linebreak(subj);
   } else {
-    return make_softbreak(subj->mem);
+    return make_softbreak(subj);
   }
 }
 
 static bufsize_t subject_find_special_char(subject *subj, int options) {
   // "\r\n\\`&_*[]<!"
-  static const int8_t SPECIAL_CHARS[256] = {
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1,
-      1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-  // " ' . -
-  static const char SMART_PUNCT_CHARS[] = {
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  };
+#define SPECIAL(n)                                                             \
+  CMARK_BYTESET_NIB('\r', n) | CMARK_BYTESET_NIB('\n', n) |                    \
+      CMARK_BYTESET_NIB('\\', n) | CMARK_BYTESET_NIB('`', n) |                  \
+      CMARK_BYTESET_NIB('&', n) | CMARK_BYTESET_NIB('_', n) |                   \
+      CMARK_BYTESET_NIB('*', n) | CMARK_BYTESET_NIB('[', n) |                   \
+      CMARK_BYTESET_NIB(']', n) | CMARK_BYTESET_NIB('<', n) |                   \
+      CMARK_BYTESET_NIB('!', n)
+  // plus " ' . -
+#define SPECIAL_SMART(n)                                                       \
+  SPECIAL(n) | CMARK_BYTESET_NIB('"', n) | CMARK_BYTESET_NIB('\'', n) |        \
+      CMARK_BYTESET_NIB('.', n) | CMARK_BYTESET_NIB('-', n)
+  static const cmark_byteset SPECIAL_CHARS = CMARK_BYTESET(SPECIAL, false);
+  static const cmark_byteset SPECIAL_SMART_CHARS =
+      CMARK_BYTESET(SPECIAL_SMART, false);
+#undef SPECIAL
+#undef SPECIAL_SMART
 
   bufsize_t n = subj->pos + 1;
 
-  while (n < subj->input.len) {
-    if (SPECIAL_CHARS[subj->input.data[n]])
-      return n;
-    if (options & CMARK_OPT_SMART && SMART_PUNCT_CHARS[subj->input.data[n]])
-      return n;
-    n++;
-  }
+  if (n >= subj->input.len)
+    return subj->input.len;
 
-  return subj->input.len;
+  return n + cmark_byteset_find(options & CMARK_OPT_SMART
+                                    ? &SPECIAL_SMART_CHARS
+                                    : &SPECIAL_CHARS,
+                                subj->input.data + n, subj->input.len - n);
 }
 
 // Parse an inline, advancing subject, and add it as a child of parent.
@@ -1289,11 +1379,19 @@ static int parse_inline(subject *subj, cmark_node *parent, int options) {
 }
 
 // Parse inlines from parent's string_content, adding as children of parent.
+// 'label_buf' is scratch space for normalizing link labels.
 extern void cmark_parse_inlines(cmark_mem *mem, cmark_node *parent,
-                                cmark_reference_map *refmap, int options) {
+                                cmark_reference_map *refmap,
+                                cmark_strbuf *label_buf,
+                                cmark_inline_pool *pool,
+                                cmark_node_cache *nodes, int options) {
   subject subj;
-  cmark_chunk content = {parent->content.ptr, parent->content.size, 0};
-  subject_from_buf(mem, parent->start_line, parent->start_column - 1 + parent->internal_offset, &subj, &content, refmap);
+  cmark_chunk *parent_content = cmark_node_content(parent);
+  cmark_chunk content = {parent_content->data, parent_content->len, 0};
+  subject_from_buf(mem, cmark_cold(parent)->start_line, cmark_cold(parent)->start_column - 1 + parent->internal_offset, &subj, &content, refmap, label_buf, pool, nodes);
+  // Content that points into the input (see CMARK_OPT_RETAIN_SOURCE)
+  // does not own its memory.
+  subj.read_only = !parent_content->alloc && parent_content->len > 0;
   cmark_chunk_rtrim(&subj.input);
 
   while (!is_eof(&subj) && parse_inline(&subj, parent, options))
@@ -1307,6 +1405,7 @@ extern void cmark_parse_inlines(cmark_mem *mem, cmark_node *parent,
   while (subj.last_bracket) {
     pop_bracket(&subj);
   }
+  cmark_chunk_free(mem, &subj.scan_copy);
 }
 
 // Parse zero or more space characters, including at most one newline.
@@ -1332,7 +1431,7 @@ bufsize_t cmark_parse_reference_inline(cmark_mem *mem, cmark_chunk *input,
   bufsize_t matchlen = 0;
   bufsize_t beforetitle;
 
-  subject_from_buf(mem, -1, 0, &subj, input, NULL);
+  subject_from_buf(mem, -1, 0, &subj, input, NULL, NULL, NULL, NULL);
 
   // parse label:
   if (!link_label(&subj, &lab) || lab.len == 0)
@@ -8,8 +8,17 @@ extern "C" {
 cmark_chunk cmark_clean_url(cmark_mem *mem, cmark_chunk *url);
 cmark_chunk cmark_clean_title(cmark_mem *mem, cmark_chunk *title);
 
+// Recycles the delimiter and bracket records of cmark_parse_inlines
+// across the blocks of a document.
+typedef struct cmark_inline_pool cmark_inline_pool;
+
+cmark_inline_pool *cmark_inline_pool_new(cmark_mem *mem);
+void cmark_inline_pool_free(cmark_inline_pool *pool);
+
 void cmark_parse_inlines(cmark_mem *mem, cmark_node *parent,
-                         cmark_reference_map *refmap, int options);
+                         cmark_reference_map *refmap, cmark_strbuf *label_buf,
+                         cmark_inline_pool *pool, cmark_node_cache *nodes,
+                         int options);
 
 bufsize_t cmark_parse_reference_inline(cmark_mem *mem, cmark_chunk *input,
                                        cmark_reference_map *refmap);
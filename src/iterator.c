@@ -16,7 +16,7 @@ cmark_iter *cmark_iter_new(cmark_node *root) {
   if (root == NULL) {
     return NULL;
   }
-  cmark_mem *mem = root->content.mem;
+  cmark_mem *mem = root->mem;
   cmark_iter *iter = (cmark_iter *)mem->calloc(1, sizeof(cmark_iter));
   iter->mem = mem;
   iter->root = root;
@@ -100,19 +100,34 @@ void cmark_consolidate_text_nodes(cmark_node *root) {
     cur = cmark_iter_get_node(iter);
     if (ev_type == CMARK_EVENT_ENTER && cur->type == CMARK_NODE_TEXT &&
         cur->next && cur->next->type == CMARK_NODE_TEXT) {
-      cmark_strbuf_clear(&buf);
-      cmark_strbuf_put(&buf, cur->as.literal.data, cur->as.literal.len);
+      cmark_chunk *literal = &cur->as.literal;
       tmp = cur->next;
-      while (tmp && tmp->type == CMARK_NODE_TEXT) {
+      // Literals that are adjacent slices of the same string (the content
+      // of their block, or the input) are merged without copying.
+      while (tmp && tmp->type == CMARK_NODE_TEXT && !literal->alloc &&
+             !tmp->as.literal.alloc && literal->data != NULL &&
+             literal->data + literal->len == tmp->as.literal.data) {
         cmark_iter_next(iter); // advance pointer
-        cmark_strbuf_put(&buf, tmp->as.literal.data, tmp->as.literal.len);
-        cur->end_column = tmp->end_column;
+        literal->len += tmp->as.literal.len;
+        cmark_cold(cur)->end_column = cmark_cold(tmp)->end_column;
         next = tmp->next;
         cmark_node_free(tmp);
         tmp = next;
       }
-      cmark_chunk_free(iter->mem, &cur->as.literal);
-      cur->as.literal = cmark_chunk_buf_detach(&buf);
+      if (tmp && tmp->type == CMARK_NODE_TEXT) {
+        cmark_strbuf_clear(&buf);
+        cmark_strbuf_put(&buf, literal->data, literal->len);
+        while (tmp && tmp->type == CMARK_NODE_TEXT) {
+          cmark_iter_next(iter); // advance pointer
+          cmark_strbuf_put(&buf, tmp->as.literal.data, tmp->as.literal.len);
+          cmark_cold(cur)->end_column = cmark_cold(tmp)->end_column;
+          next = tmp->next;
+          cmark_node_free(tmp);
+          tmp = next;
+        }
+        cmark_chunk_free(iter->mem, literal);
+        *literal = cmark_chunk_buf_detach(&buf);
+      }
     }
   }
 
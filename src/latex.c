@@ -12,6 +12,8 @@
 #include "render.h"
 
 #define OUT(s, wrap, escaping) renderer->out(renderer, s, wrap, escaping)
+#define OUT_N(s, len, wrap, escaping)                                          \
+  renderer->out_n(renderer, s, (bufsize_t)(len), wrap, escaping)
 #define LIT(s) renderer->out(renderer, s, false, LITERAL)
 #define CR() renderer->cr(renderer)
 #define BLANKLINE() renderer->blankline(renderer)
@@ -150,7 +152,7 @@ typedef enum {
 } link_type;
 
 static link_type get_link_type(cmark_node *node) {
-  size_t title_len, url_len;
+  cmark_chunk *url;
   cmark_node *link_text;
   char *realurl;
   int realurllen;
@@ -160,39 +162,32 @@ static link_type get_link_type(cmark_node *node) {
     return NO_LINK;
   }
 
-  const char *url = cmark_node_get_url(node);
-  cmark_chunk url_chunk = cmark_chunk_literal(url);
+  url = &node->as.link.url;
 
-  if (url && *url == '#') {
+  if (url->len > 0 && url->data[0] == '#') {
     return INTERNAL_LINK;
   }
 
-  url_len = strlen(url);
-  if (url_len == 0 || scan_scheme(&url_chunk, 0) == 0) {
+  if (url->len == 0 || scan_scheme(url, 0) == 0) {
     return NO_LINK;
   }
 
-  const char *title = cmark_node_get_title(node);
-  title_len = strlen(title);
   // if it has a title, we can't treat it as an autolink:
-  if (title_len == 0) {
+  if (node->as.link.title.len == 0) {
 
     link_text = node->first_child;
-    cmark_consolidate_text_nodes(link_text);
 
     if (!link_text)
       return NO_LINK;
 
-    realurl = (char *)url;
-    realurllen = (int)url_len;
-    if (strncmp(realurl, "mailto:", 7) == 0) {
+    realurl = (char *)url->data;
+    realurllen = url->len;
+    if (realurllen >= 7 && strncmp(realurl, "mailto:", 7) == 0) {
       realurl += 7;
       realurllen -= 7;
       isemail = true;
     }
-    if (realurllen == link_text->as.literal.len &&
-        strncmp(realurl, (char *)link_text->as.literal.data,
-                link_text->as.literal.len) == 0) {
+    if (cmark_render_text_equals(link_text, realurl, realurllen)) {
       if (isemail) {
         return EMAIL_AUTOLINK;
       } else {
@@ -225,6 +220,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   bool entering = (ev_type == CMARK_EVENT_ENTER);
   cmark_list_type list_type;
   bool allow_wrap = renderer->width > 0 && !(CMARK_OPT_NOBREAKS & options);
+  const char *str;
+  size_t len;
 
   // avoid warning about unused parameter:
   (void)(options);
@@ -318,7 +315,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     CR();
     LIT("\\begin{verbatim}");
     CR();
-    OUT(cmark_node_get_literal(node), false, LITERAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     CR();
     LIT("\\end{verbatim}");
     BLANKLINE();
@@ -329,8 +327,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_CUSTOM_BLOCK:
     CR();
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     CR();
     break;
 
@@ -347,7 +346,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_TEXT:
-    OUT(cmark_node_get_literal(node), allow_wrap, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, allow_wrap, NORMAL);
     break;
 
   case CMARK_NODE_LINEBREAK:
@@ -368,7 +368,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_CODE:
     LIT("\\texttt{");
-    OUT(cmark_node_get_literal(node), false, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, false, NORMAL);
     LIT("}");
     break;
 
@@ -376,8 +377,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_CUSTOM_INLINE:
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     break;
 
   case CMARK_NODE_STRONG:
@@ -398,27 +400,28 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_LINK:
     if (entering) {
-      const char *url = cmark_node_get_url(node);
+      size_t url_len;
+      const char *url = cmark_node_get_url_n(node, &url_len);
       // requires \usepackage{hyperref}
       switch (get_link_type(node)) {
       case URL_AUTOLINK:
         LIT("\\url{");
-        OUT(url, false, URL);
+        OUT_N(url, url_len, false, URL);
         LIT("}");
         return 0; // Don't process further nodes to avoid double-rendering artefacts
       case EMAIL_AUTOLINK:
         LIT("\\href{");
-        OUT(url, false, URL);
+        OUT_N(url, url_len, false, URL);
         LIT("}\\nolinkurl{");
         break;
       case NORMAL_LINK:
         LIT("\\href{");
-        OUT(url, false, URL);
+        OUT_N(url, url_len, false, URL);
         LIT("}{");
         break;
       case INTERNAL_LINK:
         LIT("\\protect\\hyperlink{");
-        OUT(url + 1, false, URL);
+        OUT_N(url + 1, url_len - 1, false, URL);
         LIT("}{");
         break;
       case NO_LINK:
@@ -434,7 +437,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     if (entering) {
       LIT("\\protect\\includegraphics{");
       // requires \include{graphicx}
-      OUT(cmark_node_get_url(node), false, URL);
+      str = cmark_node_get_url_n(node, &len);
+      OUT_N(str, len, false, URL);
       LIT("}");
       return 0;
     }
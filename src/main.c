@@ -40,17 +40,47 @@ void print_usage() {
   printf("  --unsafe         Render raw HTML and dangerous URLs\n");
   printf("  --smart          Use smart punctuation\n");
   printf("  --validate-utf8  Replace invalid UTF-8 sequences with U+FFFD\n");
+  printf("  --threads N      Use up to N threads for large documents\n");
   printf("  --help, -h       Print usage information\n");
   printf("  --version        Print version\n");
 }
 
+// All of the input, for parsing on several threads.
+typedef struct {
+  char *data;
+  size_t len;
+  size_t alloc;
+} input_buffer;
+
+static void append_input(input_buffer *input, const char *data, size_t len) {
+  if (input->len + len > input->alloc) {
+    input->alloc = (input->len + len) * 2;
+    input->data = (char *)realloc(input->data, input->alloc);
+    if (input->data == NULL) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  memcpy(input->data + input->len, data, len);
+  input->len += len;
+}
+
+static int write_stdout(const char *data, size_t len, void *userdata) {
+  (void)userdata;
+  return fwrite(data, 1, len, stdout) != len;
+}
+
 static void print_document(cmark_node *document, writer_format writer,
-                           int options, int width) {
+                           int options, int width, int threads) {
   char *result;
 
   switch (writer) {
   case FORMAT_HTML:
-    result = cmark_render_html(document, options);
+    if (threads <= 1) {
+      cmark_render_html_to(document, options, write_stdout, NULL);
+      return;
+    }
+    result = cmark_render_html_parallel(document, options, threads);
     break;
   case FORMAT_XML:
     result = cmark_render_xml(document, options);
@@ -80,6 +110,8 @@ int main(int argc, char *argv[]) {
   size_t bytes;
   cmark_node *document;
   int width = 0;
+  int threads = 1;
+  input_buffer input = {NULL, 0, 0};
   char *unparsed;
   writer_format writer = FORMAT_HTML;
   int options = CMARK_OPT_DEFAULT;
@@ -132,6 +164,19 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "--width requires an argument\n");
         exit(1);
       }
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      i += 1;
+      if (i < argc) {
+        threads = (int)strtol(argv[i], &unparsed, 10);
+        if (unparsed && strlen(unparsed) > 0) {
+          fprintf(stderr, "failed parsing threads '%s' at '%s'\n", argv[i],
+                  unparsed);
+          exit(1);
+        }
+      } else {
+        fprintf(stderr, "--threads requires an argument\n");
+        exit(1);
+      }
     } else if ((strcmp(argv[i], "-t") == 0) || (strcmp(argv[i], "--to") == 0)) {
       i += 1;
       if (i < argc) {
@@ -171,7 +216,10 @@ int main(int argc, char *argv[]) {
     }
 
     while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-      cmark_parser_feed(parser, buffer, bytes);
+      if (threads > 1)
+        append_input(&input, buffer, bytes);
+      else
+        cmark_parser_feed(parser, buffer, bytes);
       if (bytes < sizeof(buffer)) {
         break;
       }
@@ -183,7 +231,10 @@ int main(int argc, char *argv[]) {
   if (numfps == 0) {
 
     while ((bytes = fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
-      cmark_parser_feed(parser, buffer, bytes);
+      if (threads > 1)
+        append_input(&input, buffer, bytes);
+      else
+        cmark_parser_feed(parser, buffer, bytes);
       if (bytes < sizeof(buffer)) {
         break;
       }
@@ -197,10 +248,16 @@ int main(int argc, char *argv[]) {
   }
 #endif
 
-  document = cmark_parser_finish(parser);
+  if (threads > 1) {
+    document = cmark_parse_document_parallel(input.data, input.len, options,
+                                             threads);
+    free(input.data);
+  } else {
+    document = cmark_parser_finish(parser);
+  }
   cmark_parser_free(parser);
 
-  print_document(document, writer, options, width);
+  print_document(document, writer, options, width, threads);
 
   cmark_node_free(document);
 
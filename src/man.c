@@ -11,6 +11,8 @@
 #include "render.h"
 
 #define OUT(s, wrap, escaping) renderer->out(renderer, s, wrap, escaping)
+#define OUT_N(s, len, wrap, escaping)                                          \
+  renderer->out_n(renderer, s, (bufsize_t)(len), wrap, escaping)
 #define LIT(s) renderer->out(renderer, s, false, LITERAL)
 #define CR() renderer->cr(renderer)
 #define BLANKLINE() renderer->blankline(renderer)
@@ -76,6 +78,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   int list_number;
   bool entering = (ev_type == CMARK_EVENT_ENTER);
   bool allow_wrap = renderer->width > 0 && !(CMARK_OPT_NOBREAKS & options);
+  const char *str;
+  size_t len;
 
   // avoid unused parameter error:
   (void)(options);
@@ -135,7 +139,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   case CMARK_NODE_CODE_BLOCK:
     CR();
     LIT(".IP\n.nf\n\\f[C]\n");
-    OUT(cmark_node_get_literal(node), false, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, false, NORMAL);
     CR();
     LIT("\\f[]\n.fi");
     CR();
@@ -146,8 +151,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_CUSTOM_BLOCK:
     CR();
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     CR();
     break;
 
@@ -174,7 +180,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_TEXT:
-    OUT(cmark_node_get_literal(node), allow_wrap, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, allow_wrap, NORMAL);
     break;
 
   case CMARK_NODE_LINEBREAK:
@@ -195,7 +202,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
 
   case CMARK_NODE_CODE:
     LIT("\\f[C]");
-    OUT(cmark_node_get_literal(node), allow_wrap, NORMAL);
+    str = cmark_node_get_literal_n(node, &len);
+    OUT_N(str, len, allow_wrap, NORMAL);
     LIT("\\f[]");
     break;
 
@@ -203,8 +211,9 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
     break;
 
   case CMARK_NODE_CUSTOM_INLINE:
-    OUT(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node),
-        false, LITERAL);
+    str = entering ? cmark_node_get_on_enter_n(node, &len)
+                   : cmark_node_get_on_exit_n(node, &len);
+    OUT_N(str, len, false, LITERAL);
     break;
 
   case CMARK_NODE_STRONG:
@@ -226,7 +235,8 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   case CMARK_NODE_LINK:
     if (!entering) {
       LIT(" (");
-      OUT(cmark_node_get_url(node), allow_wrap, URL);
+      str = cmark_node_get_url_n(node, &len);
+      OUT_N(str, len, allow_wrap, URL);
       LIT(")");
     }
     break;
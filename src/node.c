@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "node.h"
+#include "arena.h"
 
 static void S_node_unlink(cmark_node *node);
 
@@ -73,8 +74,7 @@ static bool S_can_contain(cmark_node *node, cmark_node *child) {
 }
 
 cmark_node *cmark_node_new_with_mem(cmark_node_type type, cmark_mem *mem) {
-  cmark_node *node = (cmark_node *)mem->calloc(1, sizeof(*node));
-  cmark_strbuf_init(mem, &node->content, 0);
+  cmark_node *node = cmark_node_alloc(mem, NULL);
   node->type = (uint16_t)type;
 
   switch (node->type) {
@@ -106,8 +106,13 @@ cmark_node *cmark_node_new(cmark_node_type type) {
 static void S_free_nodes(cmark_node *e) {
   cmark_node *next;
   while (e != NULL) {
-    cmark_strbuf_free(&e->content);
     switch (e->type) {
+    case CMARK_NODE_PARAGRAPH:
+      cmark_chunk_free(NODE_MEM(e), &e->as.literal);
+      break;
+    case CMARK_NODE_HEADING:
+      cmark_chunk_free(NODE_MEM(e), &e->as.heading.content);
+      break;
     case CMARK_NODE_CODE_BLOCK:
       cmark_chunk_free(NODE_MEM(e), &e->as.code.info);
       cmark_chunk_free(NODE_MEM(e), &e->as.code.literal);
@@ -137,7 +142,7 @@ static void S_free_nodes(cmark_node *e) {
       e->next = e->first_child;
     }
     next = e->next;
-    NODE_MEM(e)->free(e);
+    cmark_node_dealloc(e);
     e = next;
   }
 }
@@ -145,6 +150,9 @@ static void S_free_nodes(cmark_node *e) {
 void cmark_node_free(cmark_node *node) {
   S_node_unlink(node);
   node->next = NULL;
+  // Arena memory is only released by cmark_arena_reset.
+  if (NODE_MEM(node) == &CMARK_ARENA_MEM_ALLOCATOR)
+    return;
   S_free_nodes(node);
 }
 
@@ -253,7 +261,7 @@ void *cmark_node_get_user_data(cmark_node *node) {
   if (node == NULL) {
     return NULL;
   } else {
-    return node->user_data;
+    return cmark_cold(node)->user_data;
   }
 }
 
@@ -261,10 +269,17 @@ int cmark_node_set_user_data(cmark_node *node, void *user_data) {
   if (node == NULL) {
     return 0;
   }
-  node->user_data = user_data;
+  cmark_cold(node)->user_data = user_data;
   return 1;
 }
 
+// Returns the bytes of c without copying them; see cmark_node_get_literal_n.
+static const char *S_chunk_n(cmark_chunk *c, size_t *len) {
+  if (len)
+    *len = c->len;
+  return c->data ? (const char *)c->data : "";
+}
+
 const char *cmark_node_get_literal(cmark_node *node) {
   if (node == NULL) {
     return NULL;
@@ -287,6 +302,30 @@ const char *cmark_node_get_literal(cmark_node *node) {
   return NULL;
 }
 
+const char *cmark_node_get_literal_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  switch (node->type) {
+  case CMARK_NODE_HTML_BLOCK:
+  case CMARK_NODE_TEXT:
+  case CMARK_NODE_HTML_INLINE:
+  case CMARK_NODE_CODE:
+    return S_chunk_n(&node->as.literal, len);
+
+  case CMARK_NODE_CODE_BLOCK:
+    return S_chunk_n(&node->as.code.literal, len);
+
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
 int cmark_node_set_literal(cmark_node *node, const char *content) {
   if (node == NULL) {
     return 0;
@@ -464,6 +503,20 @@ const char *cmark_node_get_fence_info(cmark_node *node) {
   }
 }
 
+const char *cmark_node_get_fence_info_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  if (node->type == CMARK_NODE_CODE_BLOCK) {
+    return S_chunk_n(&node->as.code.info, len);
+  } else {
+    return NULL;
+  }
+}
+
 int cmark_node_set_fence_info(cmark_node *node, const char *info) {
   if (node == NULL) {
     return 0;
@@ -493,6 +546,24 @@ const char *cmark_node_get_url(cmark_node *node) {
   return NULL;
 }
 
+const char *cmark_node_get_url_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  switch (node->type) {
+  case CMARK_NODE_LINK:
+  case CMARK_NODE_IMAGE:
+    return S_chunk_n(&node->as.link.url, len);
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
 int cmark_node_set_url(cmark_node *node, const char *url) {
   if (node == NULL) {
     return 0;
@@ -526,6 +597,24 @@ const char *cmark_node_get_title(cmark_node *node) {
   return NULL;
 }
 
+const char *cmark_node_get_title_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  switch (node->type) {
+  case CMARK_NODE_LINK:
+  case CMARK_NODE_IMAGE:
+    return S_chunk_n(&node->as.link.title, len);
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
 int cmark_node_set_title(cmark_node *node, const char *title) {
   if (node == NULL) {
     return 0;
@@ -559,6 +648,24 @@ const char *cmark_node_get_on_enter(cmark_node *node) {
   return NULL;
 }
 
+const char *cmark_node_get_on_enter_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  switch (node->type) {
+  case CMARK_NODE_CUSTOM_INLINE:
+  case CMARK_NODE_CUSTOM_BLOCK:
+    return S_chunk_n(&node->as.custom.on_enter, len);
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
 int cmark_node_set_on_enter(cmark_node *node, const char *on_enter) {
   if (node == NULL) {
     return 0;
@@ -592,6 +699,24 @@ const char *cmark_node_get_on_exit(cmark_node *node) {
   return NULL;
 }
 
+const char *cmark_node_get_on_exit_n(cmark_node *node, size_t *len) {
+  if (len)
+    *len = 0;
+  if (node == NULL) {
+    return NULL;
+  }
+
+  switch (node->type) {
+  case CMARK_NODE_CUSTOM_INLINE:
+  case CMARK_NODE_CUSTOM_BLOCK:
+    return S_chunk_n(&node->as.custom.on_exit, len);
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
 int cmark_node_set_on_exit(cmark_node *node, const char *on_exit) {
   if (node == NULL) {
     return 0;
@@ -613,28 +738,28 @@ int cmark_node_get_start_line(cmark_node *node) {
   if (node == NULL) {
     return 0;
   }
-  return node->start_line;
+  return cmark_cold(node)->start_line;
 }
 
 int cmark_node_get_start_column(cmark_node *node) {
   if (node == NULL) {
     return 0;
   }
-  return node->start_column;
+  return cmark_cold(node)->start_column;
 }
 
 int cmark_node_get_end_line(cmark_node *node) {
   if (node == NULL) {
     return 0;
   }
-  return node->end_line;
+  return cmark_cold(node)->end_line;
 }
 
 int cmark_node_get_end_column(cmark_node *node) {
   if (node == NULL) {
     return 0;
   }
-  return node->end_column;
+  return cmark_cold(node)->end_column;
 }
 
 // Unlink a node without adjusting its next, prev, and parent pointers.
@@ -797,8 +922,8 @@ static void S_print_error(FILE *out, cmark_node *node, const char *elem) {
     return;
   }
   fprintf(out, "Invalid '%s' in node type %s at %d:%d\n", elem,
-          cmark_node_get_type_string(node), node->start_line,
-          node->start_column);
+          cmark_node_get_type_string(node), cmark_cold(node)->start_line,
+          cmark_cold(node)->start_column);
 }
 
 int cmark_node_check(cmark_node *node, FILE *out) {
@@ -32,6 +32,7 @@ typedef struct {
 } cmark_code;
 
 typedef struct {
+  cmark_chunk content;
   int level;
   bool setext;
 } cmark_heading;
@@ -52,8 +53,19 @@ enum cmark_node__internal_flags {
   CMARK_NODE__LAST_LINE_CHECKED = (1 << 2),
 };
 
+// Fields that tree walks and renderers rarely touch live apart from
+// the rest of the node, see cmark_cold.
+typedef struct {
+  void *user_data;
+
+  int start_line;
+  int start_column;
+  int end_line;
+  int end_column;
+} cmark_node_cold;
+
 struct cmark_node {
-  cmark_strbuf content;
+  cmark_mem *mem;
 
   struct cmark_node *next;
   struct cmark_node *prev;
@@ -61,17 +73,12 @@ struct cmark_node {
   struct cmark_node *first_child;
   struct cmark_node *last_child;
 
-  void *user_data;
-
-  int start_line;
-  int start_column;
-  int end_line;
-  int end_column;
   int internal_offset;
   uint16_t type;
   uint16_t flags;
 
   union {
+    // Also holds the text of a paragraph, which its inlines point into.
     cmark_chunk literal;
     cmark_list list;
     cmark_code code;
@@ -82,9 +89,48 @@ struct cmark_node {
   } as;
 };
 
+// Nodes from the node slab keep their slot number plus one in the
+// high byte of flags.  Each chunk of the slab keeps the cold parts of
+// its CMARK_NODE__SLAB_NODES nodes in an array right before the nodes;
+// nodes allocated on their own are directly followed by theirs.
+#define CMARK_NODE__SLOT_SHIFT 8
+#define CMARK_NODE__SLAB_NODES 64
+
+static CMARK_INLINE cmark_node_cold *cmark_cold(cmark_node *node) {
+  int slot = node->flags >> CMARK_NODE__SLOT_SHIFT;
+  if (slot == 0)
+    return (cmark_node_cold *)(node + 1);
+  return (cmark_node_cold *)(node - (slot - 1)) -
+         (CMARK_NODE__SLAB_NODES - (slot - 1));
+}
+
 static CMARK_INLINE cmark_mem *cmark_node_mem(cmark_node *node) {
-  return node->content.mem;
+  return node->mem;
+}
+
+// The text of a paragraph or heading.
+static CMARK_INLINE cmark_chunk *cmark_node_content(cmark_node *node) {
+  return node->type == CMARK_NODE_HEADING ? &node->as.heading.content
+                                          : &node->as.literal;
 }
+
+// The chunk of the node slab that a parser, or a thread parsing
+// inlines for one, allocates its nodes from.  See slab.c.
+typedef struct cmark_node_cache {
+  struct slab_chunk *chunk;
+  struct node_slab *slab;
+} cmark_node_cache;
+
+// Allocate a zeroed node, including its cold part, from the cache's
+// chunk, or, if 'cache' is NULL, from the chunks shared by everyone
+// using the same allocator.
+cmark_node *cmark_node_alloc(cmark_mem *mem, cmark_node_cache *cache);
+void cmark_node_dealloc(cmark_node *node);
+// Lets go of the cache's chunk.  Its free slots go on to be used by
+// cmark_node_alloc without a cache; the chunk is freed along with its
+// last node.
+void cmark_node_cache_release(cmark_node_cache *cache);
+
 CMARK_EXPORT int cmark_node_check(cmark_node *node, FILE *out);
 
 #ifdef __cplusplus
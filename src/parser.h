@@ -27,8 +27,24 @@ struct cmark_parser {
   bool blank;
   bool partially_consumed_tab;
   cmark_strbuf curline;
+  cmark_chunk scanline;
+  bufsize_t line_length;
   bufsize_t last_line_length;
   cmark_strbuf linebuf;
+  // Text of the open leaf block content_node, see add_line, and the
+  // lines of it that have not been copied into content yet.
+  cmark_node *content_node;
+  cmark_strbuf content;
+  cmark_chunk *pending;
+  bufsize_t num_pending;
+  bufsize_t pending_alloc;
+  bufsize_t pending_size;
+  // Kept across documents, see cmark_parser_reset.
+  struct cmark_inline_pool *inline_pool;
+  cmark_strbuf label_buf;
+  cmark_node_cache node_cache;
+  // Threads for the inline phase, see cmark_parser_set_threads.
+  int threads;
   int options;
   bool last_buffer_ended_with_cr;
 };
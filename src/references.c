@@ -5,11 +5,24 @@
 #include "inlines.h"
 #include "chunk.h"
 
+#define REFMAP_INITIAL_SIZE 16
+#define REFMAP_KEEP_SIZE 1024
+
+// FNV-1a, followed by a final avalanche so that the low bits used to
+// pick a slot depend on every byte of the label.
 static unsigned int refhash(const unsigned char *link_ref) {
-  unsigned int hash = 0;
+  uint32_t hash = 2166136261u;
+
+  while (*link_ref) {
+    hash ^= *link_ref++;
+    hash *= 16777619u;
+  }
 
-  while (*link_ref)
-    hash = (*link_ref++) + (hash << 6) + (hash << 16) - hash;
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
 
   return hash;
 }
@@ -24,97 +37,115 @@ static void reference_free(cmark_reference_map *map, cmark_reference *ref) {
   }
 }
 
-// normalize reference:  collapse internal whitespace to single space,
-// remove leading/trailing whitespace, case fold
-// Return NULL if the reference name is actually empty (i.e. composed
+// normalize reference into 'normalized':  collapse internal whitespace
+// to single space, remove leading/trailing whitespace, case fold
+// Return false if the reference name is actually empty (i.e. composed
 // solely from whitespace)
-static unsigned char *normalize_reference(cmark_mem *mem, cmark_chunk *ref) {
-  cmark_strbuf normalized = CMARK_BUF_INIT(mem);
-  unsigned char *result;
+static bool normalize_reference(cmark_strbuf *normalized, cmark_chunk *ref) {
+  cmark_strbuf_clear(normalized);
 
   if (ref == NULL)
-    return NULL;
+    return false;
 
   if (ref->len == 0)
-    return NULL;
+    return false;
+
+  cmark_utf8proc_case_fold(normalized, ref->data, ref->len);
+  cmark_strbuf_trim(normalized);
+  cmark_strbuf_normalize_whitespace(normalized);
 
-  cmark_utf8proc_case_fold(&normalized, ref->data, ref->len);
-  cmark_strbuf_trim(&normalized);
-  cmark_strbuf_normalize_whitespace(&normalized);
+  return normalized->size > 0;
+}
 
-  result = cmark_strbuf_detach(&normalized);
-  assert(result);
+static void resize_table(cmark_reference_map *map, unsigned int size) {
+  cmark_reference **table =
+      (cmark_reference **)map->mem->calloc(size, sizeof(cmark_reference *));
+  unsigned int i, j;
 
-  if (result[0] == '\0') {
-    mem->free(result);
-    return NULL;
+  for (i = 0; i < map->size; ++i) {
+    cmark_reference *ref = map->table[i];
+    if (ref == NULL)
+      continue;
+    j = ref->hash & (size - 1);
+    while (table[j])
+      j = (j + 1) & (size - 1);
+    table[j] = ref;
   }
 
-  return result;
+  map->mem->free(map->table);
+  map->table = table;
+  map->size = size;
 }
 
 static void add_reference(cmark_reference_map *map, cmark_reference *ref) {
-  cmark_reference *t = ref->next = map->table[ref->hash % REFMAP_SIZE];
+  unsigned int i;
 
-  while (t) {
+  // Keep the load factor at or below 1/2.
+  if (2 * (map->count + 1) > map->size)
+    resize_table(map, map->size ? 2 * map->size : REFMAP_INITIAL_SIZE);
+
+  i = ref->hash & (map->size - 1);
+  while (map->table[i]) {
+    cmark_reference *t = map->table[i];
+    // The first definition of a label wins.
     if (t->hash == ref->hash && !strcmp((char *)t->label, (char *)ref->label)) {
       reference_free(map, ref);
       return;
     }
-
-    t = t->next;
+    i = (i + 1) & (map->size - 1);
   }
 
-  map->table[ref->hash % REFMAP_SIZE] = ref;
+  map->table[i] = ref;
+  map->count++;
 }
 
 void cmark_reference_create(cmark_reference_map *map, cmark_chunk *label,
                             cmark_chunk *url, cmark_chunk *title) {
   cmark_reference *ref;
-  unsigned char *reflabel = normalize_reference(map->mem, label);
+  cmark_strbuf reflabel = CMARK_BUF_INIT(map->mem);
 
   /* empty reference name, or composed from only whitespace */
-  if (reflabel == NULL)
+  if (!normalize_reference(&reflabel, label)) {
+    cmark_strbuf_free(&reflabel);
     return;
+  }
 
   ref = (cmark_reference *)map->mem->calloc(1, sizeof(*ref));
-  ref->label = reflabel;
+  ref->label = cmark_strbuf_detach(&reflabel);
   ref->hash = refhash(ref->label);
   ref->url = cmark_clean_url(map->mem, url);
   ref->title = cmark_clean_title(map->mem, title);
-  ref->next = NULL;
 
   add_reference(map, ref);
 }
 
 // Returns reference if refmap contains a reference with matching
-// label, otherwise NULL.
+// label, otherwise NULL.  The label is normalized into 'scratch', so
+// that with a buffer reused across calls lookups do not allocate.
 cmark_reference *cmark_reference_lookup(cmark_reference_map *map,
-                                        cmark_chunk *label) {
+                                        cmark_chunk *label,
+                                        cmark_strbuf *scratch) {
   cmark_reference *ref = NULL;
-  unsigned char *norm;
-  unsigned int hash;
+  unsigned int hash, i;
 
   if (label->len < 1 || label->len > MAX_LINK_LABEL_LENGTH)
     return NULL;
 
-  if (map == NULL)
+  if (map == NULL || map->count == 0)
     return NULL;
 
-  norm = normalize_reference(map->mem, label);
-  if (norm == NULL)
+  if (!normalize_reference(scratch, label))
     return NULL;
 
-  hash = refhash(norm);
-  ref = map->table[hash % REFMAP_SIZE];
+  hash = refhash(scratch->ptr);
+  i = hash & (map->size - 1);
 
-  while (ref) {
-    if (ref->hash == hash && !strcmp((char *)ref->label, (char *)norm))
+  while ((ref = map->table[i]) != NULL) {
+    if (ref->hash == hash && !strcmp((char *)ref->label, (char *)scratch->ptr))
       break;
-    ref = ref->next;
+    i = (i + 1) & (map->size - 1);
   }
 
-  map->mem->free(norm);
   return ref;
 }
 
@@ -124,18 +155,48 @@ void cmark_reference_map_free(cmark_reference_map *map) {
   if (map == NULL)
     return;
 
-  for (i = 0; i < REFMAP_SIZE; ++i) {
-    cmark_reference *ref = map->table[i];
-    cmark_reference *next;
+  for (i = 0; i < map->size; ++i)
+    reference_free(map, map->table[i]);
 
-    while (ref) {
-      next = ref->next;
-      reference_free(map, ref);
-      ref = next;
-    }
+  map->mem->free(map->table);
+  map->mem->free(map);
+}
+
+// Removes all references.  The table is kept for the next document,
+// unless it has grown large.
+void cmark_reference_map_clear(cmark_reference_map *map) {
+  unsigned int i;
+
+  if (map->count == 0)
+    return;
+
+  for (i = 0; i < map->size; ++i)
+    reference_free(map, map->table[i]);
+
+  if (map->size > REFMAP_KEEP_SIZE) {
+    map->mem->free(map->table);
+    map->table = NULL;
+    map->size = 0;
+  } else {
+    memset(map->table, 0, map->size * sizeof(cmark_reference *));
   }
+  map->count = 0;
+}
 
-  map->mem->free(map);
+// Moves the references of src into map.  Where labels clash, the
+// reference already in map wins, as if src was defined after it.  Both
+// maps have to use the same allocator.
+void cmark_reference_map_merge(cmark_reference_map *map,
+                               cmark_reference_map *src) {
+  unsigned int i;
+
+  for (i = 0; i < src->size; ++i) {
+    if (src->table[i]) {
+      add_reference(map, src->table[i]);
+      src->table[i] = NULL;
+    }
+  }
+  src->count = 0;
 }
 
 cmark_reference_map *cmark_reference_map_new(cmark_mem *mem) {
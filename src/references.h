@@ -7,10 +7,7 @@
 extern "C" {
 #endif
 
-#define REFMAP_SIZE 16
-
 struct cmark_reference {
-  struct cmark_reference *next;
   unsigned char *label;
   cmark_chunk url;
   cmark_chunk title;
@@ -19,17 +16,25 @@ struct cmark_reference {
 
 typedef struct cmark_reference cmark_reference;
 
+// Open-addressing hash table with linear probing.  `table` holds
+// `size` slots, always a power of two, of which `count` are in use.
 struct cmark_reference_map {
   cmark_mem *mem;
-  cmark_reference *table[REFMAP_SIZE];
+  cmark_reference **table;
+  unsigned int size;
+  unsigned int count;
 };
 
 typedef struct cmark_reference_map cmark_reference_map;
 
 cmark_reference_map *cmark_reference_map_new(cmark_mem *mem);
 void cmark_reference_map_free(cmark_reference_map *map);
+void cmark_reference_map_clear(cmark_reference_map *map);
+void cmark_reference_map_merge(cmark_reference_map *map,
+                               cmark_reference_map *src);
 cmark_reference *cmark_reference_lookup(cmark_reference_map *map,
-                                        cmark_chunk *label);
+                                        cmark_chunk *label,
+                                        cmark_strbuf *scratch);
 extern void cmark_reference_create(cmark_reference_map *map, cmark_chunk *label,
                                    cmark_chunk *url, cmark_chunk *title);
 
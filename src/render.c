@@ -18,9 +18,10 @@ static CMARK_INLINE void S_blankline(cmark_renderer *renderer) {
   }
 }
 
-static void S_out(cmark_renderer *renderer, const char *source, bool wrap,
-                  cmark_escaping escape) {
-  int length = strlen(source);
+// Renders the first length bytes of source, which need not be
+// NUL-terminated.
+static void S_out_n(cmark_renderer *renderer, const char *source,
+                    bufsize_t length, bool wrap, cmark_escaping escape) {
   unsigned char nextc;
   int32_t c;
   int i = 0;
@@ -63,7 +64,7 @@ static void S_out(cmark_renderer *renderer, const char *source, bool wrap,
     if (len == -1) { // error condition
       return;        // return without rendering rest of string
     }
-    nextc = source[i + len];
+    nextc = i + len < length ? source[i + len] : 0;
     if (c == 32 && wrap) {
       if (!renderer->begin_line) {
         last_nonspace = renderer->buffer->size;
@@ -72,12 +73,12 @@ static void S_out(cmark_renderer *renderer, const char *source, bool wrap,
         renderer->begin_line = false;
         renderer->begin_content = false;
         // skip following spaces
-        while (source[i + 1] == ' ') {
+        while (i + 1 < length && source[i + 1] == ' ') {
           i++;
         }
         // We don't allow breaks that make a digit the first character
         // because this causes problems with commonmark output.
-        if (!cmark_isdigit(source[i + 1])) {
+        if (i + 1 >= length || !cmark_isdigit(source[i + 1])) {
           renderer->last_breakable = last_nonspace;
         }
       }
@@ -133,6 +134,11 @@ static void S_out(cmark_renderer *renderer, const char *source, bool wrap,
   }
 }
 
+static void S_out(cmark_renderer *renderer, const char *source, bool wrap,
+                  cmark_escaping escape) {
+  S_out_n(renderer, source, (bufsize_t)strlen(source), wrap, escape);
+}
+
 // Assumes no newlines, assumes ascii content:
 void cmark_render_ascii(cmark_renderer *renderer, const char *s) {
   int origsize = renderer->buffer->size;
@@ -145,6 +151,29 @@ void cmark_render_code_point(cmark_renderer *renderer, uint32_t c) {
   renderer->column += 1;
 }
 
+// Returns true if the literal of node, followed by those of the text
+// nodes after it if node is a text node, equals the len bytes at s.
+// This compares what cmark_consolidate_text_nodes would produce
+// without modifying the tree, so that it can be rendered concurrently.
+bool cmark_render_text_equals(cmark_node *node, const char *s,
+                              bufsize_t len) {
+  cmark_node *cur = node;
+  cmark_chunk *literal;
+  bufsize_t pos = 0;
+
+  do {
+    literal = &cur->as.literal;
+    if (literal->len > len - pos ||
+        (literal->len > 0 && memcmp(s + pos, literal->data, literal->len)))
+      return false;
+    pos += literal->len;
+    cur = cur->next;
+  } while (node->type == CMARK_NODE_TEXT && cur &&
+           cur->type == CMARK_NODE_TEXT);
+
+  return pos == len;
+}
+
 char *cmark_render(cmark_node *root, int options, int width,
                    void (*outc)(cmark_renderer *, cmark_escaping, int32_t,
                                 unsigned char),
@@ -161,7 +190,8 @@ char *cmark_render(cmark_node *root, int options, int width,
 
   cmark_renderer renderer = {mem,   &buf, &pref, 0,           width,
                              0,     0,    true,  true,        false,
-                             false, outc, S_cr,  S_blankline, S_out};
+                             false, outc, S_cr,  S_blankline, S_out,
+                             S_out_n};
 
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
     cur = cmark_iter_get_node(iter);
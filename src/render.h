@@ -27,6 +27,8 @@ struct cmark_renderer {
   void (*cr)(struct cmark_renderer *);
   void (*blankline)(struct cmark_renderer *);
   void (*out)(struct cmark_renderer *, const char *, bool, cmark_escaping);
+  void (*out_n)(struct cmark_renderer *, const char *, bufsize_t, bool,
+                cmark_escaping);
 };
 
 typedef struct cmark_renderer cmark_renderer;
@@ -35,6 +37,8 @@ void cmark_render_ascii(cmark_renderer *renderer, const char *s);
 
 void cmark_render_code_point(cmark_renderer *renderer, uint32_t c);
 
+bool cmark_render_text_equals(cmark_node *node, const char *s, bufsize_t len);
+
 char *cmark_render(cmark_node *root, int options, int width,
                    void (*outc)(cmark_renderer *, cmark_escaping, int32_t,
                                 unsigned char),
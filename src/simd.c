@@ -0,0 +1,280 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "simd.h"
+
+// Vectorized kernels are compiled with per-function target attributes
+// and selected at run time, so the library still runs on CPUs
+// without SSSE3/AVX2.
+#if defined(HAVE_X86_TARGET_ATTRIBUTE)
+#define CMARK_SIMD_X86
+#include <immintrin.h>
+#define TARGET(t) __attribute__((target(t)))
+#define CTZ(x) __builtin_ctz(x)
+#define HAVE_SSSE3() __builtin_cpu_supports("ssse3")
+#define HAVE_AVX2() __builtin_cpu_supports("avx2")
+#elif defined(_MSC_VER) && _MSC_VER >= 1700 &&                                 \
+    (defined(_M_X64) || defined(_M_IX86))
+#define CMARK_SIMD_X86
+#include <immintrin.h>
+#include <intrin.h>
+#define TARGET(t)
+#define HAVE_SSSE3() (S_cpu_features() & 1)
+#define HAVE_AVX2() (S_cpu_features() & 2)
+
+static CMARK_INLINE int CTZ(unsigned int x) {
+  unsigned long i;
+  _BitScanForward(&i, x);
+  return (int)i;
+}
+
+// Bit 0: SSSE3, bit 1: AVX2 (with OS support for the YMM state).
+static int S_cpu_features(void) {
+  static int features = -1;
+  if (features < 0) {
+    int info[4];
+    int f = 0;
+    __cpuid(info, 1);
+    if (info[2] & (1 << 9))
+      f |= 1;
+    if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+        (_xgetbv(0) & 6) == 6) {
+      __cpuidex(info, 7, 0);
+      if (info[1] & (1 << 5))
+        f |= 2;
+    }
+    features = f;
+  }
+  return features;
+}
+#endif
+
+static bufsize_t find_scalar(const cmark_byteset *set, const uint8_t *data,
+                             bufsize_t len) {
+  bufsize_t i;
+
+  for (i = 0; i < len; i++) {
+    if (cmark_byteset_contains(set, data[i]))
+      break;
+  }
+
+  return i;
+}
+
+#ifdef CMARK_SIMD_X86
+
+TARGET("ssse3")
+static bufsize_t find_ssse3(const cmark_byteset *set, const uint8_t *data,
+                            bufsize_t len) {
+  const __m128i lo_tbl = _mm_loadu_si128((const __m128i *)set->lo);
+  const __m128i hi_tbl =
+      _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i high =
+      set->high ? _mm_set1_epi8(-128) : _mm_setzero_si128();
+  bufsize_t i;
+
+  for (i = 0; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    __m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(v, nibble));
+    __m128i hi = _mm_shuffle_epi8(
+        hi_tbl, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+    __m128i hit = _mm_and_si128(lo, hi);
+    unsigned int mask =
+        (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(hit, _mm_setzero_si128())) ^
+        0xffff;
+    mask |= (unsigned int)_mm_movemask_epi8(_mm_and_si128(v, high));
+    if (mask)
+      return i + CTZ(mask);
+  }
+
+  return i + find_scalar(set, data + i, len - i);
+}
+
+TARGET("avx2")
+static bufsize_t find_avx2(const cmark_byteset *set, const uint8_t *data,
+                           bufsize_t len) {
+  const __m256i lo_tbl = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)set->lo));
+  const __m256i hi_tbl = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16,
+      32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i high =
+      set->high ? _mm256_set1_epi8(-128) : _mm256_setzero_si256();
+  bufsize_t i;
+
+  for (i = 0; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(v, nibble));
+    __m256i hi = _mm256_shuffle_epi8(
+        hi_tbl, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i hit = _mm256_and_si256(lo, hi);
+    unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(hit, _mm256_setzero_si256()));
+    mask |= (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(v, high));
+    if (mask)
+      return i + CTZ(mask);
+  }
+
+  if (len - i >= 16)
+    return i + find_ssse3(set, data + i, len - i);
+  return i + find_scalar(set, data + i, len - i);
+}
+
+// UTF-8 validation after Keiser and Lemire, "Validating UTF-8 In Less
+// Than One Instruction Per Byte" (2021).  Each byte is classified
+// together with the one before it through three nibble lookups whose
+// results are ANDed; any bit left over names an error, except that
+// the "two continuations" bit has to be set exactly where a lead byte
+// two or three positions back demands it.
+
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+TARGET("ssse3")
+static __m128i utf8_block_errors(__m128i input, __m128i prev_input) {
+  // High nibble of the previous byte.
+  const __m128i byte_1_high_tbl = _mm_setr_epi8(
+      TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+      TOO_LONG, (char)TWO_CONTS, (char)TWO_CONTS, (char)TWO_CONTS,
+      (char)TWO_CONTS,
+      TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+      (char)(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+  // Low nibble of the previous byte.
+  const __m128i byte_1_low_tbl = _mm_setr_epi8(
+      (char)(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+      (char)(CARRY | OVERLONG_2), (char)CARRY, (char)CARRY,
+      (char)(CARRY | TOO_LARGE), (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+      (char)(CARRY | TOO_LARGE | TOO_LARGE_1000));
+  // High nibble of the current byte.
+  const __m128i byte_2_high_tbl = _mm_setr_epi8(
+      TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+      TOO_SHORT, TOO_SHORT,
+      (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+             OVERLONG_4),
+      (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+      (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+      (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+      TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+  __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+  __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+  __m128i special = _mm_and_si128(
+      _mm_and_si128(
+          _mm_shuffle_epi8(byte_1_high_tbl,
+                           _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+          _mm_shuffle_epi8(byte_1_low_tbl, _mm_and_si128(prev1, nibble))),
+      _mm_shuffle_epi8(byte_2_high_tbl,
+                       _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+  // Third and fourth bytes of 3- and 4-byte sequences must be
+  // continuations, i.e. carry TWO_CONTS.
+  __m128i must23 =
+      _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                   _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80)));
+  __m128i must23_80 = _mm_and_si128(must23, _mm_set1_epi8(-128));
+  return _mm_xor_si128(must23_80, special);
+}
+
+TARGET("ssse3")
+static int utf8_check_ssse3(const uint8_t *data, bufsize_t len) {
+  // Nonzero where a multibyte sequence starting in the last three
+  // bytes of a block would run past its end.
+  const __m128i incomplete_max =
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                    (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+  __m128i prev_input = _mm_setzero_si128();
+  __m128i prev_incomplete = _mm_setzero_si128();
+  __m128i error = _mm_setzero_si128();
+  __m128i nul = _mm_setzero_si128();
+  uint8_t tail[16];
+  bufsize_t i = 0;
+
+  while (i < len) {
+    __m128i input;
+    if (len - i >= 16) {
+      input = _mm_loadu_si128((const __m128i *)(data + i));
+    } else {
+      // Pad the last block with spaces, which cannot complete a
+      // truncated sequence.
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, data + i, len - i);
+      input = _mm_loadu_si128((const __m128i *)tail);
+    }
+    nul = _mm_or_si128(nul, _mm_cmpeq_epi8(input, _mm_setzero_si128()));
+    if (_mm_movemask_epi8(input) == 0) {
+      // All ASCII: only a sequence left open by the previous block
+      // can be wrong.
+      error = _mm_or_si128(error, prev_incomplete);
+      prev_incomplete = _mm_setzero_si128();
+    } else {
+      error = _mm_or_si128(error, utf8_block_errors(input, prev_input));
+      prev_incomplete = _mm_subs_epu8(input, incomplete_max);
+    }
+    prev_input = input;
+    i += 16;
+  }
+
+  error = _mm_or_si128(_mm_or_si128(error, prev_incomplete), nul);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+         0xffff;
+}
+
+#undef TOO_SHORT
+#undef TOO_LONG
+#undef OVERLONG_3
+#undef TOO_LARGE
+#undef SURROGATE
+#undef OVERLONG_2
+#undef TOO_LARGE_1000
+#undef OVERLONG_4
+#undef TWO_CONTS
+#undef CARRY
+
+#endif
+
+int cmark_utf8_check_simd(const uint8_t *data, bufsize_t len) {
+#ifdef CMARK_SIMD_X86
+  if (HAVE_SSSE3())
+    return utf8_check_ssse3(data, len);
+#endif
+  (void)data;
+  (void)len;
+  return -1;
+}
+
+// Mixing occasional 256-bit instructions into scalar code costs more
+// than it saves (the upper halves of the vector units have to be
+// woken up), so AVX2 is reserved for long inputs.
+#define AVX2_MIN_LEN 256
+
+bufsize_t cmark_byteset_find_long(const cmark_byteset *set,
+                                  const uint8_t *data, bufsize_t len) {
+#ifdef CMARK_SIMD_X86
+  if (len >= AVX2_MIN_LEN && HAVE_AVX2())
+    return find_avx2(set, data, len);
+  if (len >= 16 && HAVE_SSSE3())
+    return find_ssse3(set, data, len);
+#endif
+  return find_scalar(set, data, len);
+}
@@ -0,0 +1,98 @@
+#ifndef CMARK_SIMD_H
+#define CMARK_SIMD_H
+
+#include <stdint.h>
+#include "config.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A set of bytes, searched for 16 or 32 bytes at a time using the
+ * nibble-table technique: an ASCII byte c is a member iff
+ * `lo[c & 0xf] & (1 << (c >> 4))` is nonzero, which SSSE3/AVX2 can
+ * evaluate with two shuffles.  Bytes >= 0x80 are either all members
+ * or all non-members, depending on `high`.  `table` holds the same
+ * set as a plain lookup table for the scalar code.
+ *
+ * Sets are built at compile time from a list of members:
+ *
+ *     #define MY_SET(n) CMARK_BYTESET_NIB('<', n) | CMARK_BYTESET_NIB('>', n)
+ *     static const cmark_byteset my_set = CMARK_BYTESET(MY_SET, false);
+ */
+typedef struct {
+  uint8_t table[256];
+  uint8_t lo[16];
+  bool high;
+} cmark_byteset;
+
+#define CMARK_BYTESET_NIB(c, n)                                                \
+  ((((c)&0xf) == (n)) ? (uint8_t)(1 << (((c) >> 4) & 7)) : 0)
+
+#define CMARK_BYTESET_BIT_(F, h, l) (uint8_t)(((F(l)) >> (h)) & 1)
+#define CMARK_BYTESET_ROW_(F, h)                                               \
+  CMARK_BYTESET_BIT_(F, h, 0), CMARK_BYTESET_BIT_(F, h, 1),                    \
+      CMARK_BYTESET_BIT_(F, h, 2), CMARK_BYTESET_BIT_(F, h, 3),                \
+      CMARK_BYTESET_BIT_(F, h, 4), CMARK_BYTESET_BIT_(F, h, 5),                \
+      CMARK_BYTESET_BIT_(F, h, 6), CMARK_BYTESET_BIT_(F, h, 7),                \
+      CMARK_BYTESET_BIT_(F, h, 8), CMARK_BYTESET_BIT_(F, h, 9),                \
+      CMARK_BYTESET_BIT_(F, h, 10), CMARK_BYTESET_BIT_(F, h, 11),              \
+      CMARK_BYTESET_BIT_(F, h, 12), CMARK_BYTESET_BIT_(F, h, 13),              \
+      CMARK_BYTESET_BIT_(F, h, 14), CMARK_BYTESET_BIT_(F, h, 15)
+#define CMARK_BYTESET_HIGH_(x)                                                 \
+  x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x,   \
+      x, x, x, x, x, x, x
+
+#define CMARK_BYTESET(F, high)                                                 \
+  {                                                                            \
+    {CMARK_BYTESET_ROW_(F, 0), CMARK_BYTESET_ROW_(F, 1),                       \
+     CMARK_BYTESET_ROW_(F, 2), CMARK_BYTESET_ROW_(F, 3),                       \
+     CMARK_BYTESET_ROW_(F, 4), CMARK_BYTESET_ROW_(F, 5),                       \
+     CMARK_BYTESET_ROW_(F, 6), CMARK_BYTESET_ROW_(F, 7),                       \
+     CMARK_BYTESET_HIGH_(high), CMARK_BYTESET_HIGH_(high),                     \
+     CMARK_BYTESET_HIGH_(high), CMARK_BYTESET_HIGH_(high)},                    \
+        {(uint8_t)(F(0)),  (uint8_t)(F(1)),  (uint8_t)(F(2)),                  \
+         (uint8_t)(F(3)),  (uint8_t)(F(4)),  (uint8_t)(F(5)),                  \
+         (uint8_t)(F(6)),  (uint8_t)(F(7)),  (uint8_t)(F(8)),                  \
+         (uint8_t)(F(9)),  (uint8_t)(F(10)), (uint8_t)(F(11)),                 \
+         (uint8_t)(F(12)), (uint8_t)(F(13)), (uint8_t)(F(14)),                 \
+         (uint8_t)(F(15))},                                                    \
+        high                                                                   \
+  }
+
+static CMARK_INLINE bool cmark_byteset_contains(const cmark_byteset *set,
+                                                uint8_t c) {
+  return set->table[c];
+}
+
+bufsize_t cmark_byteset_find_long(const cmark_byteset *set,
+                                  const uint8_t *data, bufsize_t len);
+
+// Returns the offset of the first byte of data[0..len) that is in
+// set, or len if there is none.  Most searches end within a few
+// bytes, so the first 16 are checked inline before switching to the
+// vectorized search.
+static CMARK_INLINE bufsize_t cmark_byteset_find(const cmark_byteset *set,
+                                                 const uint8_t *data,
+                                                 bufsize_t len) {
+  bufsize_t i, n = len < 16 ? len : 16;
+
+  for (i = 0; i < n; i++) {
+    if (cmark_byteset_contains(set, data[i]))
+      return i;
+  }
+
+  return i == len ? len : i + cmark_byteset_find_long(set, data + i, len - i);
+}
+
+// Checks whether data[0..len) is well-formed UTF-8 (RFC 3629) without
+// NUL bytes.  Returns 1 if it is, 0 if it is not, or -1 if no vector
+// implementation is available and the caller has to check itself.
+int cmark_utf8_check_simd(const uint8_t *data, bufsize_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
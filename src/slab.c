@@ -0,0 +1,421 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "arena.h"
+#include "node.h"
+#include "thread.h"
+
+// Node slab.  All nodes have the same size, so instead of asking the
+// allocator for each one, they are carved out of chunks of SLAB_NODES
+// nodes, which keeps the nodes of a tree close together (and their cold
+// parts, in a separate array, out of the way).  A node finds its chunk
+// through the slot number stored in the high byte of its flags; nodes
+// with slot 0 were allocated on their own, together with their cold
+// part.
+//
+// A chunk has one owner at a time, which hands out its slots: either
+// the cmark_node_cache of a parser (or of a thread parsing inlines for
+// one), which takes no lock, or the node_slab shared by everyone using
+// the same calloc and free, which does.  The slab serves nodes created
+// through the API, from its current chunk and then from those on its
+// list of chunks with free slots.  A cache done with a chunk that has
+// free slots left puts it on that list.
+//
+// Nodes may be freed on any thread.  A freed node is pushed on its
+// chunk's stack of freed slots, which the owner takes back all at once
+// when it runs out of others.  A chunk that ran out of slots has no
+// owner until a node is freed; that node puts it on its slab's list.
+//
+// A chunk counts its references atomically: one for each live node,
+// and one for its owner.  A cache also holds one for each slot it can
+// hand out, so that it need not count them as it does; the slab does,
+// under its lock.  Whoever drops the last reference frees the chunk,
+// and so does whoever leaves the slab's as the only one.
+//
+// The arena allocator bypasses the slab: its nodes are contiguous
+// already and are never freed one by one.  So do sanitizer builds,
+// which should keep catching use of freed nodes.
+
+#if defined(__SANITIZE_ADDRESS__)
+#define SLAB_DISABLED
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SLAB_DISABLED
+#endif
+#endif
+
+#define SLAB_NODES CMARK_NODE__SLAB_NODES
+
+// Fails to compile unless cond holds.
+#define SLAB_STATIC_ASSERT(name, cond) typedef char name[(cond) ? 1 : -1]
+
+enum { CHUNK_CACHE, CHUNK_SLAB, CHUNK_ORPHAN };
+
+typedef struct node_slab {
+  struct node_slab *next;
+  void *(*calloc)(size_t, size_t);
+  void (*free)(void *);
+  cmark_mutex lock;
+  struct slab_chunk *current;
+  // Chunks with free slots, other than the current one.
+  struct slab_chunk *list;
+} node_slab;
+
+typedef struct slab_chunk {
+  node_slab *slab;
+  long refs;
+  // Who owns the chunk, one of the above.
+  long state;
+  // Freed nodes, linked through their next field.
+  void *freed;
+  // Freed nodes taken back by the owner, and how many of them a cache
+  // holds references for.
+  cmark_node *avail;
+  int navail;
+  // Slots handed out from the start.
+  int used;
+  // Links on the slab's list.
+  struct slab_chunk *prev, *next;
+  // cmark_cold relies on cold directly preceding nodes.
+  cmark_node_cold cold[SLAB_NODES];
+  cmark_node nodes[SLAB_NODES];
+} slab_chunk;
+
+SLAB_STATIC_ASSERT(cold_precedes_nodes,
+                   offsetof(slab_chunk, nodes) ==
+                       offsetof(slab_chunk, cold) +
+                           sizeof(cmark_node_cold) * SLAB_NODES);
+
+// What nodes not from the slab are allocated as.
+typedef struct {
+  cmark_node node;
+  cmark_node_cold cold;
+} node_pair;
+
+SLAB_STATIC_ASSERT(cold_follows_node,
+                   offsetof(node_pair, cold) == sizeof(cmark_node));
+
+static void slab_fail(void) {
+  fprintf(stderr, "[cmark] node allocation failed, aborting\n");
+  abort();
+}
+
+#ifndef cmark_atomic_add
+// Without atomic operations, they are done under a lock.
+static cmark_mutex atomic_lock = CMARK_MUTEX_INIT;
+
+static long S_atomic_add(long *p, long n) {
+  long result;
+
+  cmark_mutex_lock(&atomic_lock);
+  result = *p += n;
+  cmark_mutex_unlock(&atomic_lock);
+  return result;
+}
+
+static long S_atomic_cas(long *p, long from, long to) {
+  long result;
+
+  cmark_mutex_lock(&atomic_lock);
+  result = *p;
+  if (result == from)
+    *p = to;
+  cmark_mutex_unlock(&atomic_lock);
+  return result;
+}
+
+static void *S_atomic_cas_ptr(void **p, void *from, void *to) {
+  void *result;
+
+  cmark_mutex_lock(&atomic_lock);
+  result = *p;
+  if (result == from)
+    *p = to;
+  cmark_mutex_unlock(&atomic_lock);
+  return result;
+}
+
+#define cmark_atomic_add S_atomic_add
+#define cmark_atomic_cas S_atomic_cas
+#define cmark_atomic_cas_ptr S_atomic_cas_ptr
+#endif
+
+#define S_state(c) cmark_atomic_add(&(c)->state, 0)
+
+static void S_link(node_slab *slab, slab_chunk *c) {
+  c->prev = NULL;
+  c->next = slab->list;
+  if (slab->list)
+    slab->list->prev = c;
+  slab->list = c;
+}
+
+static void S_unlink(node_slab *slab, slab_chunk *c) {
+  if (c->prev)
+    c->prev->next = c->next;
+  else
+    slab->list = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+}
+
+static void S_lock(node_slab *slab, bool locked) {
+  if (!locked)
+    cmark_mutex_lock(&slab->lock);
+}
+
+static void S_unlock(node_slab *slab, bool locked) {
+  if (!locked)
+    cmark_mutex_unlock(&slab->lock);
+}
+
+// Frees the chunk if the slab owns it and it has no live nodes.
+static void S_free_unused(slab_chunk *c, bool locked) {
+  node_slab *slab = c->slab;
+  bool unused;
+
+  S_lock(slab, locked);
+  unused = S_state(c) == CHUNK_SLAB && cmark_atomic_add(&c->refs, 0) == 1;
+  if (unused) {
+    if (slab->current == c)
+      slab->current = NULL;
+    else
+      S_unlink(slab, c);
+  }
+  S_unlock(slab, locked);
+  if (unused)
+    slab->free(c);
+}
+
+static void S_drop(slab_chunk *c, long n, bool locked) {
+  long refs = cmark_atomic_add(&c->refs, -n);
+
+  if (refs == 0)
+    c->slab->free(c);
+  else if (refs == 1)
+    S_free_unused(c, locked);
+}
+
+// Puts a chunk without an owner on its slab's list, unless someone
+// else did already.  The reference the slab holds is a new one, or
+// else the caller's, who owned the chunk last.
+static bool S_adopt(slab_chunk *c, bool locked, bool add_ref) {
+  node_slab *slab = c->slab;
+  bool adopted;
+
+  S_lock(slab, locked);
+  adopted = cmark_atomic_cas(&c->state, CHUNK_ORPHAN, CHUNK_SLAB) ==
+            CHUNK_ORPHAN;
+  if (adopted) {
+    S_link(slab, c);
+    if (add_ref)
+      cmark_atomic_add(&c->refs, 1);
+    else
+      S_free_unused(c, true);
+  }
+  S_unlock(slab, locked);
+  return adopted;
+}
+
+// Lets go of a chunk its owner has no slots left in.  Nodes freed in
+// the meantime are not lost: whoever pushed the first of them adopts
+// the chunk, if the owner does not.
+static void S_orphan(slab_chunk *c, long state, bool locked) {
+  cmark_atomic_cas(&c->state, state, CHUNK_ORPHAN);
+  if (cmark_atomic_cas_ptr(&c->freed, NULL, NULL) != NULL &&
+      S_adopt(c, locked, false))
+    return;
+  S_drop(c, 1, locked);
+}
+
+void cmark_node_cache_release(cmark_node_cache *cache) {
+  slab_chunk *c = cache->chunk;
+  node_slab *slab;
+  long held;
+
+  if (c == NULL)
+    return;
+  cache->chunk = NULL;
+  held = SLAB_NODES - c->used + c->navail;
+  c->navail = 0;
+  if (held == 0) {
+    S_orphan(c, CHUNK_CACHE, false);
+    return;
+  }
+
+  slab = c->slab;
+  cmark_mutex_lock(&slab->lock);
+  cmark_atomic_cas(&c->state, CHUNK_CACHE, CHUNK_SLAB);
+  S_link(slab, c);
+  S_drop(c, held, true);
+  cmark_mutex_unlock(&slab->lock);
+}
+
+#ifndef SLAB_DISABLED
+// Slabs are a few words each and live as long as the process.  They
+// are allocated with calloc, as their allocator need not.
+static cmark_mutex slabs_lock = CMARK_MUTEX_INIT;
+static node_slab *slabs;
+
+static node_slab *S_get_slab(cmark_mem *mem) {
+  node_slab *slab;
+
+  cmark_mutex_lock(&slabs_lock);
+  for (slab = slabs; slab; slab = slab->next) {
+    if (slab->calloc == mem->calloc && slab->free == mem->free)
+      break;
+  }
+  if (slab == NULL) {
+    slab = (node_slab *)calloc(1, sizeof(*slab));
+    if (!slab)
+      slab_fail();
+    slab->calloc = mem->calloc;
+    slab->free = mem->free;
+    cmark_mutex_init(&slab->lock);
+    slab->next = slabs;
+    slabs = slab;
+  }
+  cmark_mutex_unlock(&slabs_lock);
+  return slab;
+}
+
+static slab_chunk *S_new_chunk(node_slab *slab, long state, long refs) {
+  slab_chunk *c = (slab_chunk *)slab->calloc(1, sizeof(*c));
+
+  if (!c)
+    slab_fail();
+  c->slab = slab;
+  c->state = state;
+  c->refs = refs;
+  return c;
+}
+
+// Takes a free slot for the chunk's owner, or returns NULL.  A cache
+// counts the freed nodes it takes back.
+static cmark_node *S_take(slab_chunk *c, bool cache) {
+  cmark_node *node = c->avail, *it;
+  void *head = NULL, *seen;
+  int n = 0;
+
+  if (node == NULL) {
+    while ((seen = cmark_atomic_cas_ptr(&c->freed, head, NULL)) != head)
+      head = seen;
+    node = (cmark_node *)head;
+    if (cache && node) {
+      for (it = node; it; it = it->next)
+        n++;
+      cmark_atomic_add(&c->refs, n);
+      c->navail = n;
+    }
+  }
+
+  if (node) {
+    c->avail = node->next;
+    if (cache)
+      c->navail--;
+    memset(node, 0, sizeof(*node));
+    memset(&c->cold[node - c->nodes], 0, sizeof(cmark_node_cold));
+    return node;
+  }
+
+  // Slots never handed out are still zeroed.
+  if (c->used < SLAB_NODES)
+    return &c->nodes[c->used++];
+  return NULL;
+}
+
+static cmark_node *S_init(slab_chunk *c, cmark_node *node, cmark_mem *mem) {
+  node->mem = mem;
+  node->flags = (uint16_t)((node - c->nodes + 1) << CMARK_NODE__SLOT_SHIFT);
+  return node;
+}
+
+static cmark_node *S_cache_alloc(cmark_mem *mem, cmark_node_cache *cache) {
+  cmark_node *node = NULL;
+
+  if (cache->slab == NULL || cache->slab->calloc != mem->calloc ||
+      cache->slab->free != mem->free) {
+    cmark_node_cache_release(cache);
+    cache->slab = S_get_slab(mem);
+  }
+  if (cache->chunk)
+    node = S_take(cache->chunk, true);
+  if (node == NULL) {
+    cmark_node_cache_release(cache);
+    cache->chunk = S_new_chunk(cache->slab, CHUNK_CACHE, SLAB_NODES + 1);
+    node = S_take(cache->chunk, true);
+  }
+  return S_init(cache->chunk, node, mem);
+}
+
+static cmark_node *S_slab_alloc(cmark_mem *mem) {
+  node_slab *slab = S_get_slab(mem);
+  slab_chunk *c;
+  cmark_node *node;
+
+  cmark_mutex_lock(&slab->lock);
+  for (;;) {
+    c = slab->current;
+    if (c == NULL) {
+      c = slab->list;
+      if (c)
+        S_unlink(slab, c);
+      else
+        c = S_new_chunk(slab, CHUNK_SLAB, 1);
+      slab->current = c;
+    }
+    node = S_take(c, false);
+    if (node)
+      break;
+    slab->current = NULL;
+    S_orphan(c, CHUNK_SLAB, true);
+  }
+  cmark_atomic_add(&c->refs, 1);
+  cmark_mutex_unlock(&slab->lock);
+  return S_init(c, node, mem);
+}
+#endif
+
+cmark_node *cmark_node_alloc(cmark_mem *mem, cmark_node_cache *cache) {
+  cmark_node *node;
+
+#ifndef SLAB_DISABLED
+  if (mem != &CMARK_ARENA_MEM_ALLOCATOR)
+    return cache ? S_cache_alloc(mem, cache) : S_slab_alloc(mem);
+#else
+  (void)cache;
+#endif
+
+  node = (cmark_node *)mem->calloc(1, sizeof(node_pair));
+  if (!node)
+    slab_fail();
+  node->mem = mem;
+  return node;
+}
+
+void cmark_node_dealloc(cmark_node *node) {
+  int slot = node->flags >> CMARK_NODE__SLOT_SHIFT;
+  slab_chunk *c;
+  void *head = NULL, *seen;
+
+  if (slot == 0) {
+    cmark_node_mem(node)->free(node);
+    return;
+  }
+
+  c = (slab_chunk *)((char *)(node - (slot - 1)) -
+                     offsetof(slab_chunk, nodes));
+  for (;;) {
+    node->next = (cmark_node *)head;
+    seen = cmark_atomic_cas_ptr(&c->freed, head, node);
+    if (seen == head)
+      break;
+    head = seen;
+  }
+  if (head == NULL && S_state(c) == CHUNK_ORPHAN)
+    S_adopt(c, false, true);
+  S_drop(c, 1, false);
+}
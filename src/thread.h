@@ -0,0 +1,89 @@
+#ifndef CMARK_THREAD_H
+#define CMARK_THREAD_H
+
+#include "config.h"
+
+// Minimal mutex and thread wrappers for the little process-wide state
+// the library keeps and for the optional worker threads.  Builds
+// without a thread library get a no-op lock and no CMARK_THREADS, in
+// which case callers do their work on the calling thread.
+//
+// Thread functions are declared with CMARK_THREAD_FUNC(name), take
+// their argument as `arg` and end with CMARK_THREAD_RETURN.
+//
+// The atomic operations are left undefined for compilers that offer
+// none and for builds without threads; callers then fall back to a
+// mutex, which in the latter case is free.
+
+#if defined(HAVE_PTHREADS)
+
+#include <pthread.h>
+
+#define CMARK_THREADS 1
+
+typedef pthread_mutex_t cmark_mutex;
+#define CMARK_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define cmark_mutex_init(m) pthread_mutex_init((m), NULL)
+#define cmark_mutex_destroy(m) pthread_mutex_destroy(m)
+#define cmark_mutex_lock(m) pthread_mutex_lock(m)
+#define cmark_mutex_unlock(m) pthread_mutex_unlock(m)
+
+typedef pthread_t cmark_thread;
+#define CMARK_THREAD_FUNC(name) void *name(void *arg)
+#define CMARK_THREAD_RETURN return NULL
+// Evaluates to nonzero if the thread was started.
+#define cmark_thread_create(t, fn, arg)                                        \
+  (pthread_create((t), NULL, (fn), (arg)) == 0)
+#define cmark_thread_join(t) pthread_join((t), NULL)
+
+#if defined(__GNUC__)
+// Adds n to the long *p and evaluates to the result.
+#define cmark_atomic_add(p, n) __sync_add_and_fetch((p), (n))
+// Sets *p to new if it is old, and evaluates to what *p was; for a long
+// and for a void * respectively.
+#define cmark_atomic_cas(p, old, new)                                          \
+  __sync_val_compare_and_swap((p), (old), (new))
+#define cmark_atomic_cas_ptr(p, old, new)                                      \
+  __sync_val_compare_and_swap((p), (old), (new))
+#endif
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+#include <process.h>
+
+#define CMARK_THREADS 1
+
+typedef SRWLOCK cmark_mutex;
+#define CMARK_MUTEX_INIT SRWLOCK_INIT
+#define cmark_mutex_init(m) InitializeSRWLock(m)
+#define cmark_mutex_destroy(m) ((void)(m))
+#define cmark_mutex_lock(m) AcquireSRWLockExclusive(m)
+#define cmark_mutex_unlock(m) ReleaseSRWLockExclusive(m)
+
+typedef HANDLE cmark_thread;
+#define CMARK_THREAD_FUNC(name) unsigned __stdcall name(void *arg)
+#define CMARK_THREAD_RETURN return 0
+#define cmark_thread_create(t, fn, arg)                                        \
+  ((*(t) = (HANDLE)_beginthreadex(NULL, 0, (fn), (arg), 0, NULL)) != 0)
+#define cmark_thread_join(t)                                                   \
+  (WaitForSingleObject((t), INFINITE), CloseHandle(t))
+
+#define cmark_atomic_add(p, n) (InterlockedExchangeAdd((p), (n)) + (n))
+#define cmark_atomic_cas(p, old, new)                                          \
+  InterlockedCompareExchange((p), (new), (old))
+#define cmark_atomic_cas_ptr(p, old, new)                                      \
+  InterlockedCompareExchangePointer((p), (new), (old))
+
+#else
+
+typedef int cmark_mutex;
+#define CMARK_MUTEX_INIT 0
+#define cmark_mutex_init(m) ((void)(m))
+#define cmark_mutex_destroy(m) ((void)(m))
+#define cmark_mutex_lock(m) ((void)(m))
+#define cmark_mutex_unlock(m) ((void)(m))
+
+#endif
+
+#endif
@@ -4,6 +4,8 @@
 
 #include "cmark_ctype.h"
 #include "utf8.h"
+#include "simd.h"
+#include "case_fold.inc"
 
 static const int8_t utf8proc_utf8class[256] = {
     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
@@ -107,10 +109,41 @@ static int utf8proc_valid(const uint8_t *str, bufsize_t str_len) {
   return length;
 }
 
+// Returns true if str is valid UTF-8 without NUL bytes, so that
+// cmark_utf8proc_check would copy it unchanged.
+static bool utf8_is_clean(const uint8_t *str, bufsize_t len) {
+  bufsize_t i = 0;
+  int check = cmark_utf8_check_simd(str, len);
+
+  if (check >= 0)
+    return check;
+
+  while (i < len) {
+    if (str[i] < 0x80) {
+      if (str[i] == 0)
+        return false;
+      i++;
+    } else {
+      int charlen = utf8proc_valid(str + i, len - i);
+      if (charlen < 0)
+        return false;
+      i += charlen;
+    }
+  }
+
+  return true;
+}
+
 void cmark_utf8proc_check(cmark_strbuf *ob, const uint8_t *line,
                           bufsize_t size) {
   bufsize_t i = 0;
 
+  // Valid lines, the common case, are copied in one go.
+  if (utf8_is_clean(line, size)) {
+    cmark_strbuf_put(ob, line, size);
+    return;
+  }
+
   while (i < size) {
     bufsize_t org = i;
     int charlen = 0;
@@ -224,17 +257,73 @@ void cmark_utf8proc_encode_char(int32_t uc, cmark_strbuf *buf) {
   cmark_strbuf_put(buf, dst, len);
 }
 
+// Lower-cases n ASCII bytes from src into dst, eight at a time.  A
+// byte is in 'A'..'Z' iff adding 0x80 - 'A' sets its top bit and
+// adding 0x7f - 'Z' does not; as all bytes are below 0x80 the sums
+// cannot carry into the next byte.
+static void fold_ascii(uint8_t *dst, const uint8_t *src, bufsize_t n) {
+  static const uint64_t ones = 0x0101010101010101ULL;
+  bufsize_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    uint64_t x, upper;
+
+    memcpy(&x, src + i, 8);
+    upper = (x + ones * (0x80 - 'A')) & ~(x + ones * (0x7f - 'Z')) &
+            (ones * 0x80);
+    x |= upper >> 2;
+    memcpy(dst + i, &x, 8);
+  }
+
+  for (; i < n; i++)
+    dst[i] = src[i] >= 'A' && src[i] <= 'Z' ? src[i] + 32 : src[i];
+}
+
+// Returns the length of the run of ASCII bytes at the start of str.
+static bufsize_t ascii_run(const uint8_t *str, bufsize_t len) {
+  bufsize_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x;
+
+    memcpy(&x, str + i, 8);
+    if (x & 0x8080808080808080ULL)
+      break;
+  }
+
+  while (i < len && str[i] < 0x80)
+    i++;
+  return i;
+}
+
 void cmark_utf8proc_case_fold(cmark_strbuf *dest, const uint8_t *str,
                               bufsize_t len) {
   int32_t c;
 
-#define bufpush(x) cmark_utf8proc_encode_char(x, dest)
+  // Folding rarely changes the length.
+  cmark_strbuf_grow(dest, dest->size + len);
 
   while (len > 0) {
-    bufsize_t char_len = cmark_utf8proc_iterate(str, len, &c);
-
-    if (char_len >= 0) {
-#include "case_fold_switch.inc"
+    bufsize_t char_len = ascii_run(str, len);
+
+    if (char_len > 0) {
+      cmark_strbuf_grow(dest, dest->size + char_len);
+      fold_ascii(dest->ptr + dest->size, str, char_len);
+      dest->size += char_len;
+      dest->ptr[dest->size] = '\0';
+    } else if ((char_len = cmark_utf8proc_iterate(str, len, &c)) >= 0) {
+      uint16_t fold = 0;
+
+      if (c < CMARK_CASE_FOLD_LIMIT)
+        fold = cmark_case_fold_index
+            [(cmark_case_fold_blocks[c >> CMARK_CASE_FOLD_BLOCK_BITS]
+              << CMARK_CASE_FOLD_BLOCK_BITS) +
+             (c & ((1 << CMARK_CASE_FOLD_BLOCK_BITS) - 1))];
+
+      if (fold)
+        cmark_strbuf_put(dest, cmark_case_fold_data + (fold >> 4), fold & 0xf);
+      else
+        cmark_strbuf_put(dest, str, char_len);
     } else {
       encode_unknown(dest);
       char_len = -char_len;
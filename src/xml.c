@@ -43,10 +43,11 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     cmark_strbuf_putc(xml, '<');
     cmark_strbuf_puts(xml, cmark_node_get_type_string(node));
 
-    if (options & CMARK_OPT_SOURCEPOS && node->start_line != 0) {
+    if (options & CMARK_OPT_SOURCEPOS && cmark_cold(node)->start_line != 0) {
+      cmark_node_cold *cold = cmark_cold(node);
       snprintf(buffer, BUFFER_SIZE, " sourcepos=\"%d:%d-%d:%d\"",
-               node->start_line, node->start_column, node->end_line,
-               node->end_column);
+               cold->start_line, cold->start_column, cold->end_line,
+               cold->end_column);
       cmark_strbuf_puts(xml, buffer);
     }
 
@@ -1,8 +1,15 @@
-# Creates C data structures for binary lookup table of entities,
+# Creates C data structures for perfect hash lookup of entities,
 # using python's html5 entity data.
 # Usage: python3 tools/make_entities_inc.py > src/entities.inc
+#
+# Lookups hash the entity name once with FNV-1a.  The low bits of
+# that hash select a bucket, whose seed is mixed into the hash to
+# pick a slot; the seeds are chosen here so that no two entities
+# share a slot.  The hash functions must match entity_hash and
+# entity_slot in src/houdini_html_u.c.
 
 import html
+import sys
 
 entities5 = html.entities.html5
 
@@ -11,11 +18,57 @@ entities5 = html.entities.html5
 # without a semicolon.
 entities = sorted([(k[:-1], entities5[k].encode('utf-8')) for k in entities5.keys() if k[-1] == ';'])
 
+NUM_BUCKETS = 512
+NUM_SLOTS = 4096
+MASK32 = 0xffffffff
+
+def entity_hash(name):
+  h = 2166136261
+  for c in name.encode('ascii'):
+    h = ((h ^ c) * 16777619) & MASK32
+  return h
+
+def entity_slot(h, seed):
+  h ^= seed
+  h ^= h >> 16
+  h = (h * 0x85ebca6b) & MASK32
+  h ^= h >> 13
+  h = (h * 0xc2b2ae35) & MASK32
+  h ^= h >> 16
+  return h & (NUM_SLOTS - 1)
+
+buckets = [[] for _ in range(NUM_BUCKETS)]
+for (i, (ent, bs)) in enumerate(entities):
+  h = entity_hash(ent)
+  buckets[h & (NUM_BUCKETS - 1)].append((i, h))
+
+# Place the largest buckets first, while most slots are still free.
+seeds = [0] * NUM_BUCKETS
+slots = [0] * NUM_SLOTS
+for b in sorted(range(NUM_BUCKETS), key=lambda b: -len(buckets[b])):
+  if not buckets[b]:
+    break
+  for seed in range(1 << 16):
+    taken = [entity_slot(h, seed) for (i, h) in buckets[b]]
+    if len(set(taken)) == len(taken) and all(slots[s] == 0 for s in taken):
+      break
+  else:
+    sys.exit("no seed found for bucket %d" % b)
+  seeds[b] = seed
+  for ((i, h), s) in zip(buckets[b], taken):
+    # slot values are offset by one so that 0 marks an empty slot
+    slots[s] = i + 1
+
+def print_array(values, per_line):
+  for i in range(0, len(values), per_line):
+    print(', '.join(map(str, values[i:i + per_line])) + ',')
+
 # Print out the header:
-print("""/* Autogenerated by tools/make_headers_inc.py */
+print("""/* Autogenerated by tools/make_entities_inc.py */
 
 struct cmark_entity_node {
 	unsigned char *entity;
+	unsigned char length;
         unsigned char bytes[8];
 };
 
@@ -23,10 +76,20 @@ struct cmark_entity_node {
 #define CMARK_ENTITY_MAX_LENGTH 32""")
 
 print("#define CMARK_NUM_ENTITIES " + str(len(entities)));
+print("#define CMARK_ENTITY_HASH_BUCKETS " + str(NUM_BUCKETS));
+print("#define CMARK_ENTITY_HASH_SLOTS " + str(NUM_SLOTS));
 
 print("\nstatic const struct cmark_entity_node cmark_entities[] = {");
 
 for (ent, bs) in entities:
-  print('{(unsigned char*)"' + ent + '", {' + ', '.join(map(str, bs)) + ', 0}},')
+  print('{(unsigned char*)"' + ent + '", ' + str(len(ent)) + ', {' + ', '.join(map(str, bs)) + ', 0}},')
+
+print("};")
+
+print("\nstatic const uint16_t cmark_entity_seeds[] = {");
+print_array(seeds, 16)
+print("};")
 
+print("\nstatic const uint16_t cmark_entity_slots[] = {");
+print_array(slots, 16)
 print("};")
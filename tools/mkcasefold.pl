@@ -1,22 +1,89 @@
-binmode STDOUT;
-print("    switch (c) {\n");
-my $lastchar = "";
+# Creates the case folding tables used by cmark_utf8proc_case_fold
+# from Unicode's CaseFolding.txt.
+# Usage: perl tools/mkcasefold.pl < data/CaseFolding.txt > src/case_fold.inc
+#
+# Code points are looked up in two steps: cmark_case_fold_blocks maps
+# each block of 128 code points to a block of cmark_case_fold_index,
+# which holds (offset << 4 | length) of the folded UTF-8 in
+# cmark_case_fold_data, or 0 for code points that fold to themselves.
+# Identical blocks (most of them are empty) are stored once.
+
+use strict;
+use warnings;
+
+my $BLOCK_BITS = 7;
+my $BLOCK_SIZE = 1 << $BLOCK_BITS;
+
+sub utf8 {
+  my ($c) = @_;
+  return ($c) if $c < 0x80;
+  return (0xC0 | ($c >> 6), 0x80 | ($c & 0x3F)) if $c < 0x800;
+  return (0xE0 | ($c >> 12), 0x80 | (($c >> 6) & 0x3F), 0x80 | ($c & 0x3F))
+    if $c < 0x10000;
+  return (0xF0 | ($c >> 18), 0x80 | (($c >> 12) & 0x3F),
+          0x80 | (($c >> 6) & 0x3F), 0x80 | ($c & 0x3F));
+}
+
+my %folds;
+my $max = 0;
 while (<STDIN>) {
   if (/^[A-F0-9]/ and / [CF]; /) {
     my ($char, $type, $subst) = m/([A-F0-9]+); ([CF]); ([^;]+)/;
-    if ($char eq $lastchar) {
-      break;
+    my $c = hex($char);
+    next if exists $folds{$c};
+    $folds{$c} = [map { utf8(hex($_)) } ($subst =~ m/(\w+)/g)];
+    $max = $c if $c > $max;
+  }
+}
+
+my @data;
+my %data_offsets;
+my @index;
+my @blocks;
+my %block_numbers;
+my $num_blocks = ($max >> $BLOCK_BITS) + 1;
+
+for my $b (0 .. $num_blocks - 1) {
+  my @block;
+  for my $c ($b << $BLOCK_BITS .. (($b + 1) << $BLOCK_BITS) - 1) {
+    if (!exists $folds{$c}) {
+      push @block, 0;
+      next;
     }
-    my @subst = $subst =~ m/(\w+)/g;
-    printf("      case 0x%s:\n", $char);
-    foreach (@subst) {
-      printf("        bufpush(0x%s);\n", $_);
+    my @bytes = @{$folds{$c}};
+    my $key = join(',', @bytes);
+    if (!exists $data_offsets{$key}) {
+      $data_offsets{$key} = scalar(@data);
+      push @data, @bytes;
     }
-    printf("        break;\n");
-    $lastchar = $char;
+    die "too much folding data\n" if $data_offsets{$key} >= 4096;
+    push @block, ($data_offsets{$key} << 4) | scalar(@bytes);
+  }
+  my $key = join(',', @block);
+  if (!exists $block_numbers{$key}) {
+    $block_numbers{$key} = scalar(@index) / $BLOCK_SIZE;
+    push @index, @block;
+  }
+  die "too many blocks\n" if $block_numbers{$key} > 255;
+  push @blocks, $block_numbers{$key};
+}
+
+sub print_array {
+  my ($per_line, @values) = @_;
+  while (@values) {
+    print(join(', ', splice(@values, 0, $per_line)), ",\n");
   }
 }
-printf("      default:\n");
-printf("        bufpush(c);\n");
-print("    }\n");
 
+print("/* Autogenerated by tools/mkcasefold.pl */\n\n");
+printf("#define CMARK_CASE_FOLD_BLOCK_BITS %d\n", $BLOCK_BITS);
+printf("#define CMARK_CASE_FOLD_LIMIT 0x%X\n\n", $num_blocks << $BLOCK_BITS);
+print("static const uint8_t cmark_case_fold_blocks[] = {\n");
+print_array(16, @blocks);
+print("};\n\n");
+print("static const uint16_t cmark_case_fold_index[] = {\n");
+print_array(12, @index);
+print("};\n\n");
+print("static const uint8_t cmark_case_fold_data[] = {\n");
+print_array(16, @data);
+print("};\n");